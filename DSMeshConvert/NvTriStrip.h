@@ -17,6 +17,9 @@
 //GeForce3 cache size
 #define CACHESIZE_GEFORCE3   24
 
+//No post-transform cache at all (e.g. the DS geometry engine)
+#define CACHESIZE_NONE       0
+
 enum PrimType
 {
 	PT_LIST,
@@ -24,16 +27,18 @@ enum PrimType
 	PT_FAN
 };
 
-struct PrimitiveGroup
+//IndexType is either unsigned short or unsigned int
+template <class IndexType>
+struct PrimitiveGroupT
 {
 	PrimType type;
 	unsigned int numIndices;
-	unsigned short* indices;
+	IndexType* indices;
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
-	PrimitiveGroup() : type(PT_STRIP), numIndices(0), indices(NULL) {}
-	~PrimitiveGroup()
+	PrimitiveGroupT() : type(PT_STRIP), numIndices(0), indices(NULL) {}
+	~PrimitiveGroupT()
 	{
 		if(indices)
 			delete[] indices;
@@ -41,6 +46,40 @@ struct PrimitiveGroup
 	}
 };
 
+typedef PrimitiveGroupT<unsigned short> PrimitiveGroup;
+typedef PrimitiveGroupT<unsigned int>   PrimitiveGroup32;
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// StripContext
+//
+// Holds the stripifier settings, and scratch buffers kept from one call to the next.
+// Give each thread its own context to generate strips in parallel.
+// The functions below which don't take a context all work on one default context.
+//
+struct StripScratch;
+
+struct StripContext
+{
+	unsigned int cacheSize;      // see SetCacheSize()
+	bool bStitchStrips;          // see SetStitchStrips()
+	unsigned int minStripSize;   // see SetMinStripSize()
+	bool bListsOnly;             // see SetListsOnly()
+	unsigned int restartVal;     // see EnableRestart()
+	bool bRestart;
+
+	StripScratch* scratch;       // allocated by the first GenerateStrips() call
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+	StripContext();
+	~StripContext();
+
+private:
+	StripContext(const StripContext&);
+	StripContext& operator=(const StripContext&);
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // EnableRestart()
@@ -70,6 +109,9 @@ void DisableRestart();
 // This is the "actual" cache size, so 24 for GeForce3 and 16 for GeForce1/2
 // You may want to play around with this number to tweak performance.
 //
+// CACHESIZE_NONE skips the cache simulation entirely: strips are never split up
+//  or reordered, they come back as long as the stripifier could make them.
+//
 // Default value: 16
 //
 void SetCacheSize(const unsigned int cacheSize);
@@ -117,11 +159,33 @@ void SetListsOnly(const bool bListsOnly);
 // primGroups: array of optimized/stripified PrimitiveGroups
 // numGroups: number of groups returned
 //
+// The indices can be unsigned short or unsigned int, the returned groups use the same type.
+//
 // Be sure to call delete[] on the returned primGroups to avoid leaking mem
 //
+template <class IndexType>
+bool GenerateStrips(const IndexType* in_indices, const unsigned int in_numIndices,
+					PrimitiveGroupT<IndexType>** primGroups, unsigned int* numGroups, bool validateEnabled = false);
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GenerateStrips()
+//
+// The original 16-bit interface, forwarding to the one above. Fails if the mesh needs
+//  more groups than numGroups can count.
+//
 bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numIndices,
 					PrimitiveGroup** primGroups, unsigned short* numGroups, bool validateEnabled = false);
 
+////////////////////////////////////////////////////////////////////////////////////////
+// GenerateStrips()
+//
+// Same as above, using the settings and scratch buffers of context instead of the
+//  default context. Calls with different contexts can run concurrently.
+//
+template <class IndexType>
+bool GenerateStrips(StripContext& context, const IndexType* in_indices, const unsigned int in_numIndices,
+					PrimitiveGroupT<IndexType>** primGroups, unsigned int* numGroups, bool validateEnabled = false);
+
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // RemapIndices()
@@ -139,6 +203,15 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 //
 // Credit goes to the MS Xbox crew for the idea for this interface.
 //
+template <class IndexType>
+void RemapIndices(const PrimitiveGroupT<IndexType>* in_primGroups, const unsigned int numGroups, 
+				  const unsigned int numVerts, PrimitiveGroupT<IndexType>** remappedGroups);
+
+////////////////////////////////////////////////////////////////////////////////////////
+// RemapIndices()
+//
+// The original 16-bit interface, forwarding to the one above.
+//
 void RemapIndices(const PrimitiveGroup* in_primGroups, const unsigned short numGroups, 
 				  const unsigned short numVerts, PrimitiveGroup** remappedGroups);
 
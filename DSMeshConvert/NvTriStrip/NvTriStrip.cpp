@@ -2,24 +2,42 @@
 #include "NvTriStripObjects.h"
 #include "NvTriStrip.h"
 
+////////////////////////////////////////////////////////////////////////////////////////
+//scratch buffers of a context
+struct StripScratch
+{
+	IntVec stripIndices;
+};
+
+StripContext::StripContext()
+	: cacheSize(CACHESIZE_GEFORCE1_2)
+	, bStitchStrips(true)
+	, minStripSize(0)
+	, bListsOnly(false)
+	, restartVal(0)
+	, bRestart(false)
+	, scratch(NULL)
+{
+}
+
+StripContext::~StripContext()
+{
+	delete scratch;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 //private data
-static unsigned int cacheSize    = CACHESIZE_GEFORCE1_2;
-static bool bStitchStrips         = true;
-static unsigned int minStripSize = 0;
-static bool bListsOnly            = false;
-static unsigned int restartVal   = 0;
-static bool bRestart              = false;
+static StripContext defaultContext;
 
 void EnableRestart(const unsigned int _restartVal)
 {
-	bRestart = true;
-	restartVal = _restartVal;
+	defaultContext.bRestart = true;
+	defaultContext.restartVal = _restartVal;
 }
 
 void DisableRestart()
 {
-	bRestart = false;
+	defaultContext.bRestart = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -31,7 +49,7 @@ void DisableRestart()
 //
 void SetListsOnly(const bool _bListsOnly)
 {
-	bListsOnly = _bListsOnly;
+	defaultContext.bListsOnly = _bListsOnly;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -42,11 +60,14 @@ void SetListsOnly(const bool _bListsOnly)
 // This is the "actual" cache size, so 24 for GeForce3 and 16 for GeForce1/2
 // You may want to play around with this number to tweak performance.
 //
+// CACHESIZE_NONE skips the cache simulation entirely: strips are never split up
+//  or reordered, they come back as long as the stripifier could make them.
+//
 // Default value: 16
 //
 void SetCacheSize(const unsigned int _cacheSize)
 {
-	cacheSize = _cacheSize;
+	defaultContext.cacheSize = _cacheSize;
 }
 
 
@@ -62,7 +83,7 @@ void SetCacheSize(const unsigned int _cacheSize)
 //
 void SetStitchStrips(const bool _bStitchStrips)
 {
-	bStitchStrips = _bStitchStrips;
+	defaultContext.bStitchStrips = _bStitchStrips;
 }
 
 
@@ -76,34 +97,23 @@ void SetStitchStrips(const bool _bStitchStrips)
 //
 void SetMinStripSize(const unsigned int _minStripSize)
 {
-	minStripSize = _minStripSize;
+	defaultContext.minStripSize = _minStripSize;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////////////
 //Cleanup strips / faces, used by generatestrips
-void Cleanup(NvStripInfoVec& tempStrips, NvFaceInfoVec& tempFaces)
+//the faces belong to the stripifier and are freed along with it
+void Cleanup(NvStripifier& stripifier, NvStripInfoVec& tempStrips, NvFaceInfoVec& tempFaces)
 {
-	int i;
-	//delete strips
-	for(i = 0; i < tempStrips.size(); i++)
+	//free strips
+	for(int i = 0; i < tempStrips.size(); i++)
 	{
-		for(int j = 0; j < tempStrips[i]->m_faces.size(); j++)
-		{
-			delete tempStrips[i]->m_faces[j];
-			tempStrips[i]->m_faces[j] = NULL;
-		}
-		tempStrips[i]->m_faces.resize(0);
-		delete tempStrips[i];
+		stripifier.FreeStrip(tempStrips[i]);
 		tempStrips[i] = NULL;
 	}
 
-	//delete faces
-	for(i = 0; i < tempFaces.size(); i++)
-	{
-		delete tempFaces[i];
-		tempFaces[i] = NULL;
-	}
+	tempFaces.clear();
 }
 
 
@@ -113,8 +123,8 @@ void Cleanup(NvStripInfoVec& tempStrips, NvFaceInfoVec& tempFaces)
 //Returns true if the two triangles defined by firstTri and secondTri are the same
 // The "same" is defined in this case as having the same indices with the same winding order
 //
-bool SameTriangle(unsigned short firstTri0, unsigned short firstTri1, unsigned short firstTri2, 
-				  unsigned short secondTri0, unsigned short secondTri1, unsigned short secondTri2)
+bool SameTriangle(unsigned int firstTri0, unsigned int firstTri1, unsigned int firstTri2, 
+				  unsigned int secondTri0, unsigned int secondTri1, unsigned int secondTri2)
 {
 	bool isSame = false;
 
@@ -147,7 +157,7 @@ bool SameTriangle(unsigned short firstTri0, unsigned short firstTri1, unsigned s
 }
 
 
-bool TestTriangle(const unsigned short v0, const unsigned short v1, const unsigned short v2, const std::vector<NvFaceInfo>* in_bins, const int NUMBINS)
+bool TestTriangle(const unsigned int v0, const unsigned int v1, const unsigned int v2, const std::vector<NvFaceInfo>* in_bins, const int NUMBINS)
 {
 	//hash this triangle
 	bool isLegit = false;
@@ -207,21 +217,34 @@ bool TestTriangle(const unsigned short v0, const unsigned short v1, const unsign
 //
 // Be sure to call delete[] on the returned primGroups to avoid leaking mem
 //
-bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numIndices,
-					PrimitiveGroup** primGroups, unsigned short* numGroups, bool validateEnabled)
+template <class IndexType>
+bool GenerateStrips(const IndexType* in_indices, const unsigned int in_numIndices,
+					PrimitiveGroupT<IndexType>** primGroups, unsigned int* numGroups, bool validateEnabled)
+{
+	return GenerateStrips(defaultContext, in_indices, in_numIndices, primGroups, numGroups, validateEnabled);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GenerateStrips()
+//
+// Same as above, with the settings of context
+//
+template <class IndexType>
+bool GenerateStrips(StripContext& context, const IndexType* in_indices, const unsigned int in_numIndices,
+					PrimitiveGroupT<IndexType>** primGroups, unsigned int* numGroups, bool validateEnabled)
 {
-	//put data in format that the stripifier likes
-	WordVec tempIndices;
-	tempIndices.resize(in_numIndices);
-	unsigned short maxIndex = 0;
-	unsigned short minIndex = 0xFFFF;
+	typedef PrimitiveGroupT<IndexType> PrimitiveGroup;
+
+	if(context.scratch == NULL)
+		context.scratch = new StripScratch;
+
+	//the stripifier reads the indices in place, it only needs their range
+	IndexType maxIndex = 0;
 	for(int i = 0; i < in_numIndices; i++)
 	{
-		tempIndices[i] = in_indices[i];
 		if (in_indices[i] > maxIndex)
 			maxIndex = in_indices[i];
-		if (in_indices[i] < minIndex)
-			minIndex = in_indices[i];
 	}
 	NvStripInfoVec tempStrips;
 	NvFaceInfoVec tempFaces;
@@ -229,13 +252,15 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 	NvStripifier stripifier;
 	
 	//do actual stripification
-	stripifier.Stripify(tempIndices, cacheSize, minStripSize, maxIndex, tempStrips, tempFaces);
+	stripifier.Stripify(in_indices, in_numIndices, context.cacheSize, context.minStripSize, maxIndex, tempStrips, tempFaces);
 
 	//stitch strips together
-	IntVec stripIndices;
+	IntVec& stripIndices = context.scratch->stripIndices;
+	stripIndices.clear();
 	unsigned int numSeparateStrips = 0;
+	const bool bStitchStrips = context.bStitchStrips;
 
-	if(bListsOnly)
+	if(context.bListsOnly)
 	{
 		//if we're outputting only lists, we're done
 		*numGroups = 1;
@@ -255,7 +280,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 
 		primGroupArray[0].type       = PT_LIST;
 		primGroupArray[0].numIndices = numIndices;
-		primGroupArray[0].indices    = new unsigned short[numIndices];
+		primGroupArray[0].indices    = new IndexType[numIndices];
 
 		//do strips
 		unsigned int indexCtr = 0;
@@ -288,7 +313,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 	}
 	else
 	{
-		stripifier.CreateStrips(tempStrips, stripIndices, bStitchStrips, numSeparateStrips, bRestart, restartVal);
+		stripifier.CreateStrips(tempStrips, stripIndices, bStitchStrips, numSeparateStrips, context.bRestart, context.restartVal);
 
 		//if we're stitching strips together, we better get back only one strip from CreateStrips()
 		assert( (bStitchStrips && (numSeparateStrips == 1)) || !bStitchStrips);
@@ -323,7 +348,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 				stripLength = stripIndices.size();
 			
 			primGroupArray[stripCtr].type       = PT_STRIP;
-			primGroupArray[stripCtr].indices    = new unsigned short[stripLength];
+			primGroupArray[stripCtr].indices    = new IndexType[stripLength];
 			primGroupArray[stripCtr].numIndices = stripLength;
 			
 			int indexCtr = 0;
@@ -340,7 +365,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 		{
 			int faceGroupLoc = (*numGroups) - 1;    //the face group is the last one
 			primGroupArray[faceGroupLoc].type       = PT_LIST;
-			primGroupArray[faceGroupLoc].indices    = new unsigned short[tempFaces.size() * 3];
+			primGroupArray[faceGroupLoc].indices    = new IndexType[tempFaces.size() * 3];
 			primGroupArray[faceGroupLoc].numIndices = tempFaces.size() * 3;
 			int indexCtr = 0;
 			for(int i = 0; i < tempFaces.size(); i++)
@@ -374,9 +399,9 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 				{
 					for (int j = 0; j < (*primGroups)[i].numIndices; j += 3)
 					{
-						unsigned short v0 = (*primGroups)[i].indices[j];
-						unsigned short v1 = (*primGroups)[i].indices[j + 1];
-						unsigned short v2 = (*primGroups)[i].indices[j + 2];
+						IndexType v0 = (*primGroups)[i].indices[j];
+						IndexType v1 = (*primGroups)[i].indices[j + 1];
+						IndexType v2 = (*primGroups)[i].indices[j + 2];
 						
 						//ignore degenerates
 						if (NvStripifier::IsDegenerate(v0, v1, v2))
@@ -384,7 +409,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 
 						if (!TestTriangle(v0, v1, v2, in_bins, NUMBINS))
 						{
-							Cleanup(tempStrips, tempFaces);
+							Cleanup(stripifier, tempStrips, tempFaces);
 							return false;
 						}
 					}
@@ -397,14 +422,14 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 					bool flip = false;
 					for (int j = 2; j < (*primGroups)[i].numIndices; ++j)
 					{
-						unsigned short v0 = (*primGroups)[i].indices[j - 2];
-						unsigned short v1 = (*primGroups)[i].indices[j - 1];
-						unsigned short v2 = (*primGroups)[i].indices[j];
+						IndexType v0 = (*primGroups)[i].indices[j - 2];
+						IndexType v1 = (*primGroups)[i].indices[j - 1];
+						IndexType v2 = (*primGroups)[i].indices[j];
 						
 						if (flip)
 						{
 							//swap v1 and v2
-							unsigned short swap = v1;
+							IndexType swap = v1;
 							v1 = v2;
 							v2 = swap;
 						}
@@ -418,7 +443,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 
 						if (!TestTriangle(v0, v1, v2, in_bins, NUMBINS))
 						{
-							Cleanup(tempStrips, tempFaces);
+							Cleanup(stripifier, tempStrips, tempFaces);
 							return false;
 						}
 
@@ -436,7 +461,7 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 	}
 
 	//clean up everything
-	Cleanup(tempStrips, tempFaces);
+	Cleanup(stripifier, tempStrips, tempFaces);
 
 	return true;
 }
@@ -456,10 +481,11 @@ bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numI
 // Note that, according to the remapping handed back to you, you must reorder your 
 //  vertex buffer.
 //
-void RemapIndices(const PrimitiveGroup* in_primGroups, const unsigned short numGroups,
-				  const unsigned short numVerts, PrimitiveGroup** remappedGroups)
+template <class IndexType>
+void RemapIndices(const PrimitiveGroupT<IndexType>* in_primGroups, const unsigned int numGroups,
+				  const unsigned int numVerts, PrimitiveGroupT<IndexType>** remappedGroups)
 {
-	(*remappedGroups) = new PrimitiveGroup[numGroups];
+	(*remappedGroups) = new PrimitiveGroupT<IndexType>[numGroups];
 
 	//caches oldIndex --> newIndex conversion
 	int *indexCache;
@@ -475,7 +501,7 @@ void RemapIndices(const PrimitiveGroup* in_primGroups, const unsigned short numG
 		//init remapped group
 		(*remappedGroups)[i].type       = in_primGroups[i].type;
 		(*remappedGroups)[i].numIndices = numIndices;
-		(*remappedGroups)[i].indices    = new unsigned short[numIndices];
+		(*remappedGroups)[i].indices    = new IndexType[numIndices];
 
 		for(int j = 0; j < numIndices; j++)
 		{
@@ -497,4 +523,58 @@ void RemapIndices(const PrimitiveGroup* in_primGroups, const unsigned short numG
 	}
 
 	delete[] indexCache;
-}
\ No newline at end of file
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the index types the stripifier is built for
+template bool GenerateStrips<unsigned short>(const unsigned short* in_indices, const unsigned int in_numIndices,
+											 PrimitiveGroupT<unsigned short>** primGroups, unsigned int* numGroups, bool validateEnabled);
+template bool GenerateStrips<unsigned int>(const unsigned int* in_indices, const unsigned int in_numIndices,
+										   PrimitiveGroupT<unsigned int>** primGroups, unsigned int* numGroups, bool validateEnabled);
+template bool GenerateStrips<unsigned short>(StripContext& context, const unsigned short* in_indices, const unsigned int in_numIndices,
+											 PrimitiveGroupT<unsigned short>** primGroups, unsigned int* numGroups, bool validateEnabled);
+template bool GenerateStrips<unsigned int>(StripContext& context, const unsigned int* in_indices, const unsigned int in_numIndices,
+										   PrimitiveGroupT<unsigned int>** primGroups, unsigned int* numGroups, bool validateEnabled);
+template void RemapIndices<unsigned short>(const PrimitiveGroupT<unsigned short>* in_primGroups, const unsigned int numGroups,
+										   const unsigned int numVerts, PrimitiveGroupT<unsigned short>** remappedGroups);
+template void RemapIndices<unsigned int>(const PrimitiveGroupT<unsigned int>* in_primGroups, const unsigned int numGroups,
+										 const unsigned int numVerts, PrimitiveGroupT<unsigned int>** remappedGroups);
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GenerateStrips()
+//
+// The original 16-bit interface
+//
+bool GenerateStrips(const unsigned short* in_indices, const unsigned int in_numIndices,
+					PrimitiveGroup** primGroups, unsigned short* numGroups, bool validateEnabled)
+{
+	unsigned int nbGroups;
+	if(!GenerateStrips(in_indices, in_numIndices, primGroups, &nbGroups, validateEnabled))
+		return false;
+
+	//the count doesn't fit, don't hand back groups the caller can't all see
+	if(nbGroups > 0xffff)
+	{
+		delete[] (*primGroups);
+		(*primGroups) = NULL;
+		*numGroups = 0;
+		return false;
+	}
+
+	*numGroups = nbGroups;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// RemapIndices()
+//
+// The original 16-bit interface
+//
+void RemapIndices(const PrimitiveGroup* in_primGroups, const unsigned short numGroups,
+				  const unsigned short numVerts, PrimitiveGroup** remappedGroups)
+{
+	RemapIndices<unsigned short>(in_primGroups, numGroups, numVerts, remappedGroups);
+}
@@ -5,17 +5,86 @@
 #include <set>
 #include "NvTriStripObjects.h"
 #include "VertexCache.h"
+#include "../thread.h"
 
 #define CACHE_INEFFICIENCY 6
 
 NvStripifier::NvStripifier()
 {
-	
+	m_pools.push_back(new NvPools);
 }
 
 NvStripifier::~NvStripifier()
 {
-	
+	for(int i = 0; i < m_pools.size(); i++)
+		delete m_pools[i];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// ReserveHash()
+//
+// sizes the edge hash to a power of two at least twice the number of edges
+//
+void NvEdgeInfoVec::ReserveHash(int numEdges)
+{
+	unsigned int size = 16;
+	while (size < (unsigned int)numEdges * 2)
+		size <<= 1;
+
+	HashEntry empty = { 0, NULL };
+	m_hash.assign(size, empty);
+	m_hashMask  = size - 1;
+	m_hashCount = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// InsertHash()
+//
+// adds an edge to the hash, growing it if it gets more than half full
+//
+void NvEdgeInfoVec::InsertHash(NvEdgeInfo *edgeInfo)
+{
+	if ((m_hashCount + 1) * 2 > m_hash.size())
+	{
+		std::vector<HashEntry> old;
+		old.swap(m_hash);
+		ReserveHash((m_hashCount + 1) * 2);
+		for (int i = 0; i < old.size(); i++)
+		{
+			if (old[i].edgeInfo != NULL)
+				InsertHash(old[i].edgeInfo);
+		}
+	}
+
+	unsigned long long key = PackKey(edgeInfo->m_v0, edgeInfo->m_v1);
+	unsigned int slot = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & m_hashMask;
+	while (m_hash[slot].edgeInfo != NULL)
+		slot = (slot + 1) & m_hashMask;
+
+	m_hash[slot].key      = key;
+	m_hash[slot].edgeInfo = edgeInfo;
+	m_hashCount++;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// FindHash()
+//
+// linear probing from the hashed slot until the key or an empty slot is found
+//
+NvEdgeInfo * NvEdgeInfoVec::FindHash(int v0, int v1) const
+{
+	unsigned long long key = PackKey(v0, v1);
+	unsigned int slot = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & m_hashMask;
+	while (m_hash[slot].edgeInfo != NULL)
+	{
+		if (m_hash[slot].key == key)
+			return m_hash[slot].edgeInfo;
+		slot = (slot + 1) & m_hashMask;
+	}
+	return NULL;
 }
 
 
@@ -26,6 +95,10 @@ NvStripifier::~NvStripifier()
 //
 NvEdgeInfo * NvStripifier::FindEdgeInfo(NvEdgeInfoVec &edgeInfos, int v0, int v1){
 	
+	// once BuildStripifyInfo() has filled the hash, it knows every edge
+	if (edgeInfos.HasHash())
+		return edgeInfos.FindHash(v0, v1);
+
 	// we can get to it through either array
 	// because the edge infos have a v0 and v1
 	// and there is no order except how it was
@@ -88,18 +161,22 @@ bool NvStripifier::AlreadyExists(NvFaceInfo* faceInfo, NvFaceInfoVec& faceInfos)
 //
 // Builds the list of all face and edge infos
 //
-void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &edgeInfos,
-									 const unsigned short maxIndex)
+template <class IndexType>
+void NvStripifier::BuildStripifyInfo(const IndexType* indices, const unsigned int numIndices,
+									 NvFaceInfoVec &faceInfos, NvEdgeInfoVec &edgeInfos,
+									 const unsigned int maxIndex)
 {
 	int i;
 	// reserve space for the face infos, but do not resize them.
-	int numIndices = indices.size();
 	faceInfos.reserve(numIndices / 3);
 	
 	// we actually resize the edge infos, so we must initialize to NULL
 	edgeInfos.resize(maxIndex + 1);
-	for (i = 0; i < maxIndex + 1; i++)
+	for (i = 0; i < edgeInfos.size(); i++)
 		edgeInfos[i] = NULL;
+
+	// every triangle adds at most three edges
+	edgeInfos.ReserveHash(numIndices);
 	
 	// iterate through the triangles of the triangle list
 	int numTriangles = numIndices / 3;
@@ -124,7 +201,7 @@ void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &ed
 		
 		// create the face info and add it to the list of faces, but only if this exact face doesn't already 
 		//  exist in the list
-		NvFaceInfo *faceInfo = new NvFaceInfo(v0, v1, v2);
+		NvFaceInfo *faceInfo = new (m_pools[0]->m_faces.Alloc()) NvFaceInfo(v0, v1, v2);
 		
 		// grab the edge infos, creating them if they do not already exist
 		NvEdgeInfo *edgeInfo01 = FindEdgeInfo(edgeInfos, v0, v1);
@@ -134,13 +211,14 @@ void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &ed
 			bMightAlreadyExist = false;
 
 			// create the info
-			edgeInfo01 = new NvEdgeInfo(v0, v1);
+			edgeInfo01 = new (m_pools[0]->m_edges.Alloc()) NvEdgeInfo(v0, v1);
 			
 			// update the linked list on both 
 			edgeInfo01->m_nextV0 = edgeInfos[v0];
 			edgeInfo01->m_nextV1 = edgeInfos[v1];
 			edgeInfos[v0] = edgeInfo01;
 			edgeInfos[v1] = edgeInfo01;
+			edgeInfos.InsertHash(edgeInfo01);
 			
 			// set face 0
 			edgeInfo01->m_face0 = faceInfo;
@@ -165,13 +243,14 @@ void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &ed
 			bMightAlreadyExist = false;
 			
 			// create the info
-			edgeInfo12 = new NvEdgeInfo(v1, v2);
+			edgeInfo12 = new (m_pools[0]->m_edges.Alloc()) NvEdgeInfo(v1, v2);
 			
 			// update the linked list on both 
 			edgeInfo12->m_nextV0 = edgeInfos[v1];
 			edgeInfo12->m_nextV1 = edgeInfos[v2];
 			edgeInfos[v1] = edgeInfo12;
 			edgeInfos[v2] = edgeInfo12;
+			edgeInfos.InsertHash(edgeInfo12);
 			
 			// set face 0
 			edgeInfo12->m_face0 = faceInfo;
@@ -196,13 +275,14 @@ void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &ed
 			bMightAlreadyExist = false;
 
 			// create the info
-			edgeInfo20 = new NvEdgeInfo(v2, v0);
+			edgeInfo20 = new (m_pools[0]->m_edges.Alloc()) NvEdgeInfo(v2, v0);
 			
 			// update the linked list on both 
 			edgeInfo20->m_nextV0 = edgeInfos[v2];
 			edgeInfo20->m_nextV1 = edgeInfos[v0];
 			edgeInfos[v2] = edgeInfo20;
 			edgeInfos[v0] = edgeInfo20;
+			edgeInfos.InsertHash(edgeInfo20);
 			
 			// set face 0
 			edgeInfo20->m_face0 = faceInfo;
@@ -223,12 +303,15 @@ void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &ed
 		if(bMightAlreadyExist)
 		{
 			if(!AlreadyExists(faceInfo, faceInfos))
+			{
+				faceInfo->m_faceIndex = faceInfos.size();
 				faceInfos.push_back(faceInfo);
+			}
 			else
 			{
-				delete faceInfo;
+				m_pools[0]->m_faces.Free(faceInfo);
 
-				//cleanup pointers that point to this deleted face
+				//cleanup pointers that point to this freed face
 				if(bFaceUpdated[0])
 					edgeInfo01->m_face1 = NULL;
 				if(bFaceUpdated[1])
@@ -239,6 +322,7 @@ void NvStripifier::BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &ed
 		}
 		else
 		{
+			faceInfo->m_faceIndex = faceInfos.size();
 			faceInfos.push_back(faceInfo);
 		}
 
@@ -433,7 +517,7 @@ void NvStripifier::GetSharedVertices(NvFaceInfo *faceA, NvFaceInfo *faceB, int*
 //
 // Returns vertex of the input face which is "next" in the input index list
 //
-inline int NvStripifier::GetNextIndex(const WordVec &indices, NvFaceInfo *face){
+inline int NvStripifier::GetNextIndex(const IntVec &indices, NvFaceInfo *face){
 	
 	int numIndices = indices.size();
 	assert(numIndices >= 2);
@@ -487,6 +571,9 @@ inline int NvStripifier::GetNextIndex(const WordVec &indices, NvFaceInfo *face){
 // experiment and the experiment index is the one we are building
 // for, then it is marked and unavailable
 inline bool NvStripInfo::IsMarked(NvFaceInfo *faceInfo){
+	if (IsExperiment() && UsesMarks(faceInfo))
+		return (faceInfo->m_stripId >= 0) || (m_marks->m_experimentId[faceInfo->m_faceIndex] == m_experimentId);
+
 	return (faceInfo->m_stripId >= 0) || (IsExperiment() && faceInfo->m_experimentId == m_experimentId);
 }
 
@@ -498,7 +585,11 @@ inline bool NvStripInfo::IsMarked(NvFaceInfo *faceInfo){
 //
 inline void NvStripInfo::MarkTriangle(NvFaceInfo *faceInfo){
 	assert(!IsMarked(faceInfo));
-	if (IsExperiment()){
+	if (IsExperiment() && UsesMarks(faceInfo)){
+		m_marks->m_experimentId[faceInfo->m_faceIndex] = m_experimentId;
+		m_marks->m_testStripId[faceInfo->m_faceIndex]  = m_stripId;
+	}
+	else if (IsExperiment()){
 		faceInfo->m_experimentId = m_experimentId;
 		faceInfo->m_testStripId  = m_stripId;
     }
@@ -556,10 +647,10 @@ bool NvStripInfo::Unique(NvFaceInfoVec& faceVec, NvFaceInfo* face)
 //
 // Builds a strip forward as far as we can go, then builds backwards, and joins the two lists
 //
-void NvStripInfo::Build(NvEdgeInfoVec &edgeInfos, NvFaceInfoVec &faceInfos)
+void NvStripInfo::Build(NvEdgeInfoVec &edgeInfos, NvFaceInfoVec &faceInfos, NvPools &pools)
 {
 	// used in building the strips forward and backward
-	WordVec scratchIndices;
+	IntVec scratchIndices;
 	
 	// build forward... start with the initial face
 	NvFaceInfoVec forwardFaces, backwardFaces;
@@ -602,7 +693,7 @@ void NvStripInfo::Build(NvEdgeInfoVec &edgeInfos, NvFaceInfoVec &faceInfos)
 				//we only swap if it buys us something
 				
 				//add a "fake" degenerate face
-				NvFaceInfo* tempFace = new NvFaceInfo(nv0, nv1, nv0, true);
+				NvFaceInfo* tempFace = new (pools.m_faces.Alloc()) NvFaceInfo(nv0, nv1, nv0, true);
 				
 				forwardFaces.push_back(tempFace);
 				MarkTriangle(tempFace);
@@ -671,7 +762,7 @@ void NvStripInfo::Build(NvEdgeInfoVec &edgeInfos, NvFaceInfoVec &faceInfos)
 				//we only swap if it buys us something
 				
 				//add a "fake" degenerate face
-				NvFaceInfo* tempFace = new NvFaceInfo(nv0, nv1, nv0, true);
+				NvFaceInfo* tempFace = new (pools.m_faces.Alloc()) NvFaceInfo(nv0, nv1, nv0, true);
 
 				backwardFaces.push_back(tempFace);
 				MarkTriangle(tempFace);
@@ -772,6 +863,7 @@ void NvStripifier::CommitStrips(NvStripInfoVec &allStrips, const NvStripInfoVec
 		// Tell the strip that it is now real
 		NvStripInfo *strip = strips[i];
 		strip->m_experimentId = -1;
+		strip->m_marks        = NULL;
 		
 		// add to the list of real strips
 		allStrips.push_back(strip);
@@ -834,6 +926,194 @@ bool NvStripifier::FindTraversal(NvFaceInfoVec &faceInfos,
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////////////
+// NvVertexUses
+//
+// Lists the items (faces or strips) using each vertex, once per use, so that the cache
+//  hits of the items can be kept up to date as vertices go in and out of the cache,
+//  instead of recounting the hits of every item before each pick
+//
+class NvVertexUses {
+public:
+	void Add(int item, const NvFaceInfo *face)
+	{
+		m_uses.push_back(std::make_pair(face->m_v0, item));
+		m_uses.push_back(std::make_pair(face->m_v1, item));
+		m_uses.push_back(std::make_pair(face->m_v2, item));
+	}
+
+	// groups the uses by vertex, call once everything was added
+	void Finish()
+	{
+		int numVertices = 0;
+		int i;
+		for(i = 0; i < m_uses.size(); i++)
+			numVertices = max(numVertices, m_uses[i].first + 1);
+
+		m_start.assign(numVertices + 1, 0);
+		for(i = 0; i < m_uses.size(); i++)
+			m_start[m_uses[i].first + 1]++;
+		for(i = 0; i < numVertices; i++)
+			m_start[i + 1] += m_start[i];
+
+		IntVec next(m_start.begin(), m_start.end() - 1);
+		m_items.resize(m_uses.size());
+		for(i = 0; i < m_uses.size(); i++)
+			m_items[next[m_uses[i].first]++] = m_uses[i].second;
+		m_uses.clear();
+	}
+
+	// the uses of vertex v are m_items[First(v)] to m_items[Last(v) - 1]
+	inline int First(int v) const { return m_start[v]; }
+	inline int Last(int v) const { return m_start[v + 1]; }
+	inline int Item(int use) const { return m_items[use]; }
+
+private:
+	std::vector<std::pair<int, int> > m_uses;
+	IntVec m_start;
+	IntVec m_items;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// NvFaceHits
+//
+// Faces bucketed by their number of cache hits, lowest index first, so that the
+//  first face with the most hits is always at hand
+//
+class NvFaceHits {
+public:
+	NvFaceHits(int numFaces) : m_hits(numFaces, 0)
+	{
+		for(int i = 0; i < numFaces; i++)
+			m_buckets[0].insert(m_buckets[0].end(), i);
+	}
+
+	void Change(int face, int delta)
+	{
+		if(m_hits[face] < 0)
+			return;
+		m_buckets[m_hits[face]].erase(face);
+		m_hits[face] += delta;
+		m_buckets[m_hits[face]].insert(face);
+	}
+
+	// takes out the face with the most hits, the first one on ties, -1 once all were picked
+	int PickBest()
+	{
+		for(int numHits = 3; numHits >= 0; numHits--)
+		{
+			if(!m_buckets[numHits].empty())
+			{
+				int face = *m_buckets[numHits].begin();
+				m_buckets[numHits].erase(m_buckets[numHits].begin());
+				m_hits[face] = -1;
+				return face;
+			}
+		}
+		return -1;
+	}
+
+private:
+	IntVec        m_hits;  // -1 once picked
+	std::set<int> m_buckets[4];
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// NvStripHits
+//
+// Strips ordered by cache hits per face, separately for each winding of their first face,
+//  so that picking the next strip doesn't need to look at all of them
+//
+class NvStripHits {
+public:
+	NvStripHits(const NvStripInfoVec &strips, const std::vector<bool> &isCW)
+		: m_hits(strips.size(), 0), m_numFaces(strips.size()), m_isCW(isCW)
+	{
+		for(int i = 0; i < strips.size(); i++)
+		{
+			m_numFaces[i] = strips[i]->m_faces.size();
+			m_byWinding[m_isCW[i]].insert(Key(i));
+		}
+	}
+
+	void Remove(int strip)
+	{
+		m_byWinding[m_isCW[strip]].erase(Key(strip));
+		m_hits[strip] = -1;
+	}
+
+	void Change(int strip, int delta)
+	{
+		if(m_hits[strip] < 0)
+			return;
+		ScoreSet &scores = m_byWinding[m_isCW[strip]];
+		scores.erase(Key(strip));
+		m_hits[strip] += delta;
+		scores.insert(Key(strip));
+	}
+
+	// takes out the strip with the most hits per face, -1 once all were picked.
+	// On ties, this is the last strip whose winding is bWantsCW, or else the first strip,
+	//  just like scanning them all in order
+	int PickBest(bool bWantsCW)
+	{
+		ScoreSet &wanted = m_byWinding[bWantsCW];
+		ScoreSet &other  = m_byWinding[!bWantsCW];
+		if(wanted.empty() && other.empty())
+			return -1;
+
+		int strip;
+		if(other.empty() || (!wanted.empty() && wanted.rbegin()->first >= other.rbegin()->first))
+			strip = wanted.rbegin()->second;
+		else
+			strip = other.lower_bound(std::make_pair(other.rbegin()->first, -1))->second;
+
+		Remove(strip);
+		return strip;
+	}
+
+private:
+	typedef std::set<std::pair<float, int> > ScoreSet;
+
+	// same score as the scan computed
+	inline std::pair<float, int> Key(int strip) const
+	{
+		return std::make_pair((float)m_hits[strip] / (float)m_numFaces[strip], strip);
+	}
+
+	IntVec            m_hits;  // -1 once picked
+	IntVec            m_numFaces;
+	std::vector<bool> m_isCW;
+	ScoreSet          m_byWinding[2];
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// AddToCache()
+//
+// Adds v to the cache if it isn't there yet, and updates the hits of the items using
+//  v and the vertex it pushed out
+//
+template <class Hits>
+static void AddToCache(VertexCache* vcache, int v, const NvVertexUses &uses, Hits &hits)
+{
+	if(vcache->InCache(v))
+		return;
+
+	int removed = vcache->AddEntry(v);
+	int use;
+	if(removed >= 0)
+	{
+		for(use = uses.First(removed); use < uses.Last(removed); use++)
+			hits.Change(uses.Item(use), -1);
+	}
+	for(use = uses.First(v); use < uses.Last(v); use++)
+		hits.Change(uses.Item(use), 1);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // RemoveSmallStrips()
 //
@@ -856,7 +1136,7 @@ void NvStripifier::RemoveSmallStrips(NvStripInfoVec& allStrips, NvStripInfoVec&
 				tempFaceList.push_back(allStrips[i]->m_faces[j]);
 			
 			//and free memory
-			delete allStrips[i];
+			m_pools[0]->m_strips.Free(allStrips[i]);
 		}
 		else
 		{
@@ -864,44 +1144,30 @@ void NvStripifier::RemoveSmallStrips(NvStripInfoVec& allStrips, NvStripInfoVec&
 		}
 	}
 	
-	if(tempFaceList.size())
+	if(tempFaceList.size() && cacheSize == 0)
+	{
+		//no cache, so there's no better order than the one we have
+		faceList = tempFaceList;
+	}
+	else if(tempFaceList.size())
 	{
-		bool *bVisitedList = new bool[tempFaceList.size()];
-		memset(bVisitedList, 0, tempFaceList.size()*sizeof(bool));
-		
 		VertexCache* vcache = new VertexCache(cacheSize);
-		
-		int bestNumHits = -1;
-		int numHits;
+
+		NvVertexUses uses;
+		for(int i = 0; i < tempFaceList.size(); i++)
+			uses.Add(i, tempFaceList[i]);
+		uses.Finish();
+
+		//pick the best face to add next, given the current cache
+		NvFaceHits hits(tempFaceList.size());
 		int bestIndex;
-		
-		while(1)
+		while((bestIndex = hits.PickBest()) != -1)
 		{
-			bestNumHits = -1;
-			
-			//find best face to add next, given the current cache
-			for(int i = 0; i < tempFaceList.size(); i++)
-			{
-				if(bVisitedList[i])
-					continue;
-				
-				numHits = CalcNumHitsFace(vcache, tempFaceList[i]);
-				if(numHits > bestNumHits)
-				{
-					bestNumHits = numHits;
-					bestIndex = i;
-				}
-			}
-			
-			if(bestNumHits == -1.0f)
-				break;
-			bVisitedList[bestIndex] = true;
-			UpdateCacheFace(vcache, tempFaceList[bestIndex]);
+			UpdateCacheFace(vcache, tempFaceList[bestIndex], uses, hits);
 			faceList.push_back(tempFaceList[bestIndex]);
 		}
 		
 		delete vcache;
-		delete[] bVisitedList;
 	}
 }
 
@@ -1106,8 +1372,9 @@ void NvStripifier::CreateStrips(const NvStripInfoVec& allStrips, IntVec& stripIn
 // in_indices are the input indices of the mesh to stripify
 // in_cacheSize is the target cache size 
 //
-void NvStripifier::Stripify(const WordVec &in_indices, const int in_cacheSize, 
-							const int in_minStripLength, const unsigned short maxIndex, 
+template <class IndexType>
+void NvStripifier::Stripify(const IndexType* in_indices, const unsigned int in_numIndices, const int in_cacheSize, 
+							const int in_minStripLength, const unsigned int maxIndex, 
 							NvStripInfoVec &outStrips, NvFaceInfoVec& outFaceList)
 {
 	meshJump = 0.0f;
@@ -1116,18 +1383,16 @@ void NvStripifier::Stripify(const WordVec &in_indices, const int in_cacheSize,
 	//the number of times to run the experiments
 	int numSamples = 10;
 	
-	//the cache size, clamped to one
-	cacheSize = max(1, in_cacheSize - CACHE_INEFFICIENCY);
+	//the cache size, clamped to one, or zero for hardware without a cache
+	cacheSize = (in_cacheSize == 0 ? 0 : max(1, in_cacheSize - CACHE_INEFFICIENCY));
 	
 	minStripLength = in_minStripLength;  //this is the strip size threshold below which we dump the strip into a list
 	
-	indices = in_indices;
-	
 	// build the stripification info
 	NvFaceInfoVec allFaceInfos;
 	NvEdgeInfoVec allEdgeInfos;
 	
-	BuildStripifyInfo(allFaceInfos, allEdgeInfos, maxIndex);
+	BuildStripifyInfo(in_indices, in_numIndices, allFaceInfos, allEdgeInfos, maxIndex);
 	
 	NvStripInfoVec allStrips;
 
@@ -1137,26 +1402,21 @@ void NvStripifier::Stripify(const WordVec &in_indices, const int in_cacheSize,
 	//split up the strips into cache friendly pieces, optimize them, then dump these into outStrips
 	SplitUpStripsAndOptimize(allStrips, outStrips, allEdgeInfos, outFaceList);
 
-	int i;
-	//clean up
-	for(i = 0; i < allStrips.size(); i++)
+	//clean up, the edges are freed with the pools
+	for(int i = 0; i < allStrips.size(); i++)
 	{
-		delete allStrips[i];
+		m_pools[0]->m_strips.Free(allStrips[i]);
 	}
-	
-	for (i = 0; i < allEdgeInfos.size(); i++)
-	{
-		NvEdgeInfo *info = allEdgeInfos[i];
-		while (info != NULL)
-		{
-			NvEdgeInfo *next = (info->m_v0 == i ? info->m_nextV0 : info->m_nextV1);
-			info->Unref();
-			info = next;
-		}
-	}
-	
 }
 
+// the index types GenerateStrips() is built for
+template void NvStripifier::Stripify<unsigned short>(const unsigned short* in_indices, const unsigned int in_numIndices, const int in_cacheSize,
+													 const int in_minStripLength, const unsigned int maxIndex,
+													 NvStripInfoVec &outStrips, NvFaceInfoVec& outFaceList);
+template void NvStripifier::Stripify<unsigned int>(const unsigned int* in_indices, const unsigned int in_numIndices, const int in_cacheSize,
+												   const int in_minStripLength, const unsigned int maxIndex,
+												   NvStripInfoVec &outStrips, NvFaceInfoVec& outFaceList);
+
 
 bool NvStripifier::IsDegenerate(const NvFaceInfo* face)
 {
@@ -1170,7 +1430,7 @@ bool NvStripifier::IsDegenerate(const NvFaceInfo* face)
 		return false;
 }
 
-bool NvStripifier::IsDegenerate(const unsigned short v0, const unsigned short v1, const unsigned short v2)
+bool NvStripifier::IsDegenerate(const unsigned int v0, const unsigned int v1, const unsigned int v2)
 {
 	if(v0 == v1)
 		return true;
@@ -1195,6 +1455,23 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 	int threshold = cacheSize;
 	NvStripInfoVec tempStrips;
 	int i;
+
+	if(cacheSize == 0)
+	{
+		//no cache: splitting only costs vertices, and reordering gains nothing,
+		// so keep the strips whole and in the order they were found
+		for(i = 0; i < allStrips.size(); i++)
+		{
+			NvStripStartInfo startInfo(NULL, NULL, false);
+			NvStripInfo* currentStrip = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(startInfo, 0, -1);
+			currentStrip->m_faces = allStrips[i]->m_faces;
+			tempStrips.push_back(currentStrip);
+		}
+
+		outStrips.clear();
+		RemoveSmallStrips(tempStrips, outStrips, outFaceList);
+		return;
+	}
 	//split up strips into threshold-sized pieces
 	for(i = 0; i < allStrips.size(); i++)
 	{
@@ -1218,7 +1495,7 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 			int j;
 			for(j = 0; j < numTimes; j++)
 			{
-				currentStrip = new NvStripInfo(startInfo, 0, -1);
+				currentStrip = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(startInfo, 0, -1);
 				
 				int faceCtr = j*threshold + degenerateCount;
 				bool bFirstTime = true;
@@ -1237,10 +1514,10 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 						}
 						else
 						{
-							//but, we do need to delete the degenerate, if it's marked fake, to avoid leaking
+							//but, we do need to free the degenerate, if it's marked fake, to avoid leaking
 							if(allStrips[i]->m_faces[faceCtr]->m_bIsFake)
 							{
-								delete allStrips[i]->m_faces[faceCtr], allStrips[i]->m_faces[faceCtr] = NULL;
+								m_pools[0]->m_faces.Free(allStrips[i]->m_faces[faceCtr]), allStrips[i]->m_faces[faceCtr] = NULL;
 							}
 							++faceCtr;
 						}
@@ -1278,7 +1555,7 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 			
 			if(numLeftover != 0)
 			{
-				currentStrip = new NvStripInfo(startInfo, 0, -1);   
+				currentStrip = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(startInfo, 0, -1);   
 				
 				int ctr = 0;
 				bool bFirstTime = true;
@@ -1297,7 +1574,7 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 						//don't leak
 						if(allStrips[i]->m_faces[leftOff]->m_bIsFake)
 						{
-							delete allStrips[i]->m_faces[leftOff], allStrips[i]->m_faces[leftOff] = NULL;
+							m_pools[0]->m_faces.Free(allStrips[i]->m_faces[leftOff]), allStrips[i]->m_faces[leftOff] = NULL;
 						}
 
 						leftOff++;
@@ -1317,7 +1594,7 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 		{
 			//we're not just doing a tempStrips.push_back(allBigStrips[i]) because
 			// this way we can delete allBigStrips later to free the memory
-			currentStrip = new NvStripInfo(startInfo, 0, -1);
+			currentStrip = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(startInfo, 0, -1);
 			
 			for(int j = 0; j < allStrips[i]->m_faces.size(); j++)
 				currentStrip->m_faces.push_back(allStrips[i]->m_faces[j]);
@@ -1340,10 +1617,7 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 		//Optimize for the vertex cache
 		VertexCache* vcache = new VertexCache(cacheSize);
 		
-		float bestNumHits = -1.0f;
-		float numHits;
 		int bestIndex;
-		bool done = false;
 		
 		int firstIndex = 0;
 		float minCost = 10000.0f;
@@ -1366,79 +1640,32 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 			}
 		}
 		
-		UpdateCacheStrip(vcache, tempStrips2[firstIndex]);
+		NvVertexUses uses;
+		std::vector<bool> isCW(tempStrips2.size());
+		for(i = 0; i < tempStrips2.size(); i++)
+		{
+			for(int j = 0; j < tempStrips2[i]->m_faces.size(); j++)
+				uses.Add(i, tempStrips2[i]->m_faces[j]);
+			isCW[i] = FirstFaceIsCW(tempStrips2[i]);
+		}
+		uses.Finish();
+
+		NvStripHits hits(tempStrips2, isCW);
+		hits.Remove(firstIndex);
+
+		UpdateCacheStrip(vcache, tempStrips2[firstIndex], uses, hits);
 		outStrips.push_back(tempStrips2[firstIndex]);
 		
 		tempStrips2[firstIndex]->visited = true;
 		
 		bool bWantsCW = (tempStrips2[firstIndex]->m_faces.size() % 2) == 0;
 
-		//this n^2 algo is what slows down stripification so much....
-		// needs to be improved
-		while(1)
+		//the best strip to add next, given the current cache, preferring
+		// ones that don't make the previous strip switch polarity
+		while((bestIndex = hits.PickBest(bWantsCW)) != -1)
 		{
-			bestNumHits = -1.0f;
-			
-			//find best strip to add next, given the current cache
-			for(int i = 0; i < tempStrips2.size(); i++)
-			{
-				if(tempStrips2[i]->visited)
-					continue;
-
-				numHits = CalcNumHitsStrip(vcache, tempStrips2[i]);
-				if(numHits > bestNumHits)
-				{
-					bestNumHits = numHits;
-					bestIndex = i;
-				}
-				else if(numHits >= bestNumHits)
-				{
-					//check previous strip to see if this one requires it to switch polarity
-					NvStripInfo *strip = tempStrips2[i];
-					int nStripFaceCount = strip->m_faces.size();
-					
-					NvFaceInfo tFirstFace(strip->m_faces[0]->m_v0, strip->m_faces[0]->m_v1, strip->m_faces[0]->m_v2);
-					
-					// If there is a second face, reorder vertices such that the
-					// unique vertex is first
-					if (nStripFaceCount > 1)
-					{
-						int nUnique = NvStripifier::GetUniqueVertexInB(strip->m_faces[1], &tFirstFace);
-						if (nUnique == tFirstFace.m_v1)
-						{
-							SWAP(tFirstFace.m_v0, tFirstFace.m_v1);
-						}
-						else if (nUnique == tFirstFace.m_v2)
-						{
-							SWAP(tFirstFace.m_v0, tFirstFace.m_v2);
-						}
-						
-						// If there is a third face, reorder vertices such that the
-						// shared vertex is last
-						if (nStripFaceCount > 2)
-						{
-							int nShared0, nShared1;
-							GetSharedVertices(strip->m_faces[2], &tFirstFace, &nShared0, &nShared1);
-							if ( (nShared0 == tFirstFace.m_v1) && (nShared1 == -1) )
-							{
-								SWAP(tFirstFace.m_v1, tFirstFace.m_v2);
-							}
-						}
-					}
-						
-					// Check CW/CCW ordering
-					if (bWantsCW == IsCW(strip->m_faces[0], tFirstFace.m_v0, tFirstFace.m_v1))
-					{
-						//I like this one!
-						bestIndex = i;
-					}
-				}
-			}
-			
-			if(bestNumHits == -1.0f)
-				break;
 			tempStrips2[bestIndex]->visited = true;
-			UpdateCacheStrip(vcache, tempStrips2[bestIndex]);
+			UpdateCacheStrip(vcache, tempStrips2[bestIndex], uses, hits);
 			outStrips.push_back(tempStrips2[bestIndex]);
 			bWantsCW = (tempStrips2[bestIndex]->m_faces.size() % 2 == 0) ? bWantsCW : !bWantsCW;
 		}
@@ -1451,88 +1678,71 @@ void NvStripifier::SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripIn
 ///////////////////////////////////////////////////////////////////////////////////////////
 // UpdateCacheStrip()
 //
-// Updates the input vertex cache with this strip's vertices
+// Updates the input vertex cache with this strip's vertices, and the hits of the strips left
 //
-void NvStripifier::UpdateCacheStrip(VertexCache* vcache, NvStripInfo* strip)
+void NvStripifier::UpdateCacheStrip(VertexCache* vcache, NvStripInfo* strip, const NvVertexUses& uses, NvStripHits& hits)
 {
 	for(int i = 0; i < strip->m_faces.size(); ++i)
 	{
-		if(!vcache->InCache(strip->m_faces[i]->m_v0))
-			vcache->AddEntry(strip->m_faces[i]->m_v0);
-		
-		if(!vcache->InCache(strip->m_faces[i]->m_v1))
-			vcache->AddEntry(strip->m_faces[i]->m_v1);
-		
-		if(!vcache->InCache(strip->m_faces[i]->m_v2))
-			vcache->AddEntry(strip->m_faces[i]->m_v2);
+		AddToCache(vcache, strip->m_faces[i]->m_v0, uses, hits);
+		AddToCache(vcache, strip->m_faces[i]->m_v1, uses, hits);
+		AddToCache(vcache, strip->m_faces[i]->m_v2, uses, hits);
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 // UpdateCacheFace()
 //
-// Updates the input vertex cache with this face's vertices
+// Updates the input vertex cache with this face's vertices, and the hits of the faces left
 //
-void NvStripifier::UpdateCacheFace(VertexCache* vcache, NvFaceInfo* face)
+void NvStripifier::UpdateCacheFace(VertexCache* vcache, NvFaceInfo* face, const NvVertexUses& uses, NvFaceHits& hits)
 {
-	if(!vcache->InCache(face->m_v0))
-		vcache->AddEntry(face->m_v0);
-		
-	if(!vcache->InCache(face->m_v1))
-		vcache->AddEntry(face->m_v1);
-		
-	if(!vcache->InCache(face->m_v2))
-		vcache->AddEntry(face->m_v2);
+	AddToCache(vcache, face->m_v0, uses, hits);
+	AddToCache(vcache, face->m_v1, uses, hits);
+	AddToCache(vcache, face->m_v2, uses, hits);
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////
-// CalcNumHitsStrip()
+// FirstFaceIsCW()
 //
-// returns the number of cache hits per face in the strip
+// Returns true if the first face of the strip is CW, once its vertices are ordered the
+//  way the strip will output them
 //
-float NvStripifier::CalcNumHitsStrip(VertexCache* vcache, NvStripInfo* strip)
+bool NvStripifier::FirstFaceIsCW(NvStripInfo* strip)
 {
-	int numHits = 0;
-	int numFaces = 0;
+	int nStripFaceCount = strip->m_faces.size();
+	
+	NvFaceInfo tFirstFace(strip->m_faces[0]->m_v0, strip->m_faces[0]->m_v1, strip->m_faces[0]->m_v2);
 	
-	for(int i = 0; i < strip->m_faces.size(); i++)
+	// If there is a second face, reorder vertices such that the
+	// unique vertex is first
+	if (nStripFaceCount > 1)
 	{
-		if(vcache->InCache(strip->m_faces[i]->m_v0))
-			++numHits;
-		
-		if(vcache->InCache(strip->m_faces[i]->m_v1))
-			++numHits;
-		
-		if(vcache->InCache(strip->m_faces[i]->m_v2))
-			++numHits;
+		int nUnique = NvStripifier::GetUniqueVertexInB(strip->m_faces[1], &tFirstFace);
+		if (nUnique == tFirstFace.m_v1)
+		{
+			SWAP(tFirstFace.m_v0, tFirstFace.m_v1);
+		}
+		else if (nUnique == tFirstFace.m_v2)
+		{
+			SWAP(tFirstFace.m_v0, tFirstFace.m_v2);
+		}
 		
-		numFaces++;
+		// If there is a third face, reorder vertices such that the
+		// shared vertex is last
+		if (nStripFaceCount > 2)
+		{
+			int nShared0, nShared1;
+			GetSharedVertices(strip->m_faces[2], &tFirstFace, &nShared0, &nShared1);
+			if ( (nShared0 == tFirstFace.m_v1) && (nShared1 == -1) )
+			{
+				SWAP(tFirstFace.m_v1, tFirstFace.m_v2);
+			}
+		}
 	}
 	
-	return ((float)numHits / (float)numFaces);
-}
-
-
-///////////////////////////////////////////////////////////////////////////////////////////
-// CalcNumHitsFace()
-//
-// returns the number of cache hits in the face
-//
-int NvStripifier::CalcNumHitsFace(VertexCache* vcache, NvFaceInfo* face)
-{
-	int numHits = 0;
-
-	if(vcache->InCache(face->m_v0))
-		numHits++;
-		
-	if(vcache->InCache(face->m_v1))
-		numHits++;
-		
-	if(vcache->InCache(face->m_v2))
-		numHits++;
-		
-	return numHits;
+	return IsCW(strip->m_faces[0], tFirstFace.m_v0, tFirstFace.m_v1);
 }
 
 
@@ -1581,6 +1791,53 @@ float NvStripifier::AvgStripSize(const NvStripInfoVec &strips){
 }
 
 
+struct NvExperimentContext {
+	NvStripifier      *stripifier;
+	NvStripInfoVec    *experiments;
+	NvExperimentMarks *marks;
+	NvFaceInfoVec     *allFaceInfos;
+	NvEdgeInfoVec     *allEdgeInfos;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// BuildExperiment()
+//
+// Builds the first strip of an experiment and the strips that follow it, marking faces
+//  in the marks of the worker thread. Strip ids only need to be unique within the
+//  experiment here, FindAllStrips() renumbers them afterwards.
+//
+void NvStripifier::BuildExperiment(unsigned int index, unsigned int worker, void* userData)
+{
+	NvExperimentContext *context = (NvExperimentContext*)userData;
+	NvStripInfoVec &experiment = context->experiments[index];
+	NvFaceInfoVec &allFaceInfos = *context->allFaceInfos;
+	NvEdgeInfoVec &allEdgeInfos = *context->allEdgeInfos;
+
+	// build the first strip of the list
+	experiment[0]->m_marks = &context->marks[worker];
+	NvPools &pools = *context->stripifier->m_pools[worker];
+	experiment[0]->Build(allEdgeInfos, allFaceInfos, pools);
+	int experimentId = experiment[0]->m_experimentId;
+	int stripId      = experiment[0]->m_stripId;
+	
+	NvStripInfo *stripIter = experiment[0];
+	NvStripStartInfo startInfo(NULL, NULL, false);
+	while (context->stripifier->FindTraversal(allFaceInfos, allEdgeInfos, stripIter, startInfo)){
+		
+		// create the new strip info
+		stripIter = new (pools.m_strips.Alloc()) NvStripInfo(startInfo, ++stripId, experimentId);
+		stripIter->m_marks = &context->marks[worker];
+		
+		// build the next strip
+		stripIter->Build(allEdgeInfos, allFaceInfos, pools);
+		
+		// add it to the list
+		experiment.push_back(stripIter);
+	}
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 // FindAllStrips()
 //
@@ -1601,6 +1858,20 @@ void NvStripifier::FindAllStrips(NvStripInfoVec &allStrips,
 	bool done        = false;
 
 	int loopCtr = 0;
+
+	// one set of experiment marks and pools per worker, worker 0 being this thread
+	ThreadPool pool;
+	while (m_pools.size() < pool.GetNbWorkers())
+		m_pools.push_back(new NvPools);
+	std::vector<NvExperimentMarks> marks(pool.GetNbWorkers());
+	for (int w = 0; w < marks.size(); w++)
+		marks[w].Reset(allFaceInfos.size());
+
+	NvExperimentContext context;
+	context.stripifier   = this;
+	context.marks        = &marks[0];
+	context.allFaceInfos = &allFaceInfos;
+	context.allEdgeInfos = &allEdgeInfos;
 	
 	while (!done)
 	{
@@ -1637,32 +1908,32 @@ void NvStripifier::FindAllStrips(NvStripInfoVec &allStrips,
 			
 			// build the strip off of this face's 0-1 edge
 			NvEdgeInfo *edge01 = FindEdgeInfo(allEdgeInfos, nextFace->m_v0, nextFace->m_v1);
-			NvStripInfo *strip01 = new NvStripInfo(NvStripStartInfo(nextFace, edge01, true), stripId++, experimentId++);
+			NvStripInfo *strip01 = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(NvStripStartInfo(nextFace, edge01, true), stripId++, experimentId++);
 			experiments[experimentIndex++].push_back(strip01);
 			
 			// build the strip off of this face's 1-0 edge
 			NvEdgeInfo *edge10 = FindEdgeInfo(allEdgeInfos, nextFace->m_v0, nextFace->m_v1);
-			NvStripInfo *strip10 = new NvStripInfo(NvStripStartInfo(nextFace, edge10, false), stripId++, experimentId++);
+			NvStripInfo *strip10 = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(NvStripStartInfo(nextFace, edge10, false), stripId++, experimentId++);
 			experiments[experimentIndex++].push_back(strip10);
 			
 			// build the strip off of this face's 1-2 edge
 			NvEdgeInfo *edge12 = FindEdgeInfo(allEdgeInfos, nextFace->m_v1, nextFace->m_v2);
-			NvStripInfo *strip12 = new NvStripInfo(NvStripStartInfo(nextFace, edge12, true), stripId++, experimentId++);
+			NvStripInfo *strip12 = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(NvStripStartInfo(nextFace, edge12, true), stripId++, experimentId++);
 			experiments[experimentIndex++].push_back(strip12);
 			
 			// build the strip off of this face's 2-1 edge
 			NvEdgeInfo *edge21 = FindEdgeInfo(allEdgeInfos, nextFace->m_v1, nextFace->m_v2);
-			NvStripInfo *strip21 = new NvStripInfo(NvStripStartInfo(nextFace, edge21, false), stripId++, experimentId++);
+			NvStripInfo *strip21 = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(NvStripStartInfo(nextFace, edge21, false), stripId++, experimentId++);
 			experiments[experimentIndex++].push_back(strip21);
 			
 			// build the strip off of this face's 2-0 edge
 			NvEdgeInfo *edge20 = FindEdgeInfo(allEdgeInfos, nextFace->m_v2, nextFace->m_v0);
-			NvStripInfo *strip20 = new NvStripInfo(NvStripStartInfo(nextFace, edge20, true), stripId++, experimentId++);
+			NvStripInfo *strip20 = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(NvStripStartInfo(nextFace, edge20, true), stripId++, experimentId++);
 			experiments[experimentIndex++].push_back(strip20);
 			
 			// build the strip off of this face's 0-2 edge
 			NvEdgeInfo *edge02 = FindEdgeInfo(allEdgeInfos, nextFace->m_v2, nextFace->m_v0);
-			NvStripInfo *strip02 = new NvStripInfo(NvStripStartInfo(nextFace, edge02, false), stripId++, experimentId++);
+			NvStripInfo *strip02 = new (m_pools[0]->m_strips.Alloc()) NvStripInfo(NvStripStartInfo(nextFace, edge02, false), stripId++, experimentId++);
 			experiments[experimentIndex++].push_back(strip02);
 		}
 		
@@ -1671,28 +1942,17 @@ void NvStripifier::FindAllStrips(NvStripInfoVec &allStrips,
 		// and really build each of the strips and strips that follow to see how
 		// far we get
 		//
+		// Experiments only read the face and edge infos, and mark faces in the
+		// marks of the worker they run on, so they are built in parallel.
+		//
 		int numExperiments = experimentIndex;
+		context.experiments = experiments;
+		pool.Run(numExperiments, BuildExperiment, &context);
+
+		// hand out the strip ids in the same order a serial run would
 		for (i = 0; i < numExperiments; i++){
-			
-			// get the strip set
-			
-			// build the first strip of the list
-			experiments[i][0]->Build(allEdgeInfos, allFaceInfos);
-			int experimentId = experiments[i][0]->m_experimentId;
-			
-			NvStripInfo *stripIter = experiments[i][0];
-			NvStripStartInfo startInfo(NULL, NULL, false);
-			while (FindTraversal(allFaceInfos, allEdgeInfos, stripIter, startInfo)){
-				
-				// create the new strip info
-				stripIter = new NvStripInfo(startInfo, stripId++, experimentId);
-				
-				// build the next strip
-				stripIter->Build(allEdgeInfos, allFaceInfos);
-				
-				// add it to the list
-				experiments[i].push_back(stripIter);
-			}
+			for (int j = 1; j < experiments[i].size(); j++)
+				experiments[i][j]->m_stripId = stripId++;
 		}
 		
 		//
@@ -1737,10 +1997,10 @@ void NvStripifier::FindAllStrips(NvStripInfoVec &allStrips,
 					{
 						if(currStrip->m_faces[k]->m_bIsFake)
 						{
-							delete currStrip->m_faces[k], currStrip->m_faces[k] = NULL;
+							m_pools[0]->m_faces.Free(currStrip->m_faces[k]), currStrip->m_faces[k] = NULL;
 						}
 					}
-					delete currStrip, currStrip = NULL, experiments[i][j] = NULL;
+					m_pools[0]->m_strips.Free(currStrip), currStrip = NULL, experiments[i][j] = NULL;
 				}
 			}
 		}
@@ -6,6 +6,7 @@
 #include <windows.h>
 #include <vector>
 #include <list>
+#include <new>
 #include "VertexCache.h"
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -36,6 +37,7 @@ public:
 		m_stripId      = -1;
 		m_testStripId  = -1;
 		m_experimentId = -1;
+		m_faceIndex    = -1;
 		m_bIsFake = bIsFake;
 	}
 	
@@ -44,7 +46,24 @@ public:
 	int   m_stripId;      // real strip Id
 	int   m_testStripId;  // strip Id in an experiment
 	int   m_experimentId; // in what experiment was it given an experiment Id?
-	bool  m_bIsFake;      //if true, will be deleted when the strip it's in is deleted
+	int   m_faceIndex;    // index in the face infos, -1 for fake faces
+	bool  m_bIsFake;      //if true, will be freed when the strip it's in is freed
+};
+
+
+// Experiment marks of one worker thread, indexed by face index.
+// Experiments running in parallel can't share the marks stored in the faces.
+// Experiment ids are unique, so the marks never need clearing.
+class NvExperimentMarks {
+public:
+	void Reset(int numFaces)
+	{
+		m_experimentId.assign(numFaces, -1);
+		m_testStripId.assign(numFaces, -1);
+	}
+
+	std::vector<int> m_experimentId;
+	std::vector<int> m_testStripId;
 };
 
 // nice and dumb edge class that points knows its
@@ -53,7 +72,7 @@ public:
 class NvEdgeInfo {
 public:
 	
-	// constructor puts 1 ref on us
+	// edges live in the stripifier's pools until it goes away
 	NvEdgeInfo (int v0, int v1){
 		m_v0       = v0;
 		m_v1       = v1;
@@ -61,19 +80,9 @@ public:
 		m_face1    = NULL;
 		m_nextV0   = NULL;
 		m_nextV1   = NULL;
-		
-		// we will appear in 2 lists.  this is a good
-		// way to make sure we delete it the second time
-		// we hit it in the edge infos
-		m_refCount = 2;    
-		
 	}
 	
-	// ref and unref
-	void Unref () { if (--m_refCount == 0) delete this; }
-	
 	// data members are left public
-	UINT         m_refCount;
 	NvFaceInfo  *m_face0, *m_face1;
 	int          m_v0, m_v1;
 	NvEdgeInfo  *m_nextV0, *m_nextV1;
@@ -100,7 +109,6 @@ public:
 typedef std::vector<NvFaceInfo*>     NvFaceInfoVec;
 typedef std::list  <NvFaceInfo*>     NvFaceInfoList;
 typedef std::list  <NvFaceInfoVec*>  NvStripList;
-typedef std::vector<NvEdgeInfo*>     NvEdgeInfoVec;
 
 typedef std::vector<WORD> WordVec;
 typedef std::vector<int> IntVec;
@@ -115,6 +123,99 @@ inline void SWAP(T& first, T& second)
 	second = temp;
 }
 
+// Chunked storage for the objects of one stripification, so they don't go through
+// the heap one by one and sit next to each other in memory.
+// Objects never move once allocated, freed ones are recycled by the next Alloc(),
+// and the memory is released all at once with the pool. Objects still allocated
+// by then don't get their destructor called.
+template <class T>
+class NvPool {
+public:
+	NvPool() : m_numUsed(CHUNK_SIZE), m_freeList(NULL) {}
+	~NvPool()
+	{
+		for(int i = 0; i < m_chunks.size(); i++)
+			delete[] m_chunks[i];
+	}
+
+	// storage for one object, to construct with placement new
+	void* Alloc()
+	{
+		if(m_freeList != NULL)
+		{
+			Slot* slot = m_freeList;
+			m_freeList = slot->m_next;
+			return slot;
+		}
+		if(m_numUsed == CHUNK_SIZE)
+		{
+			m_chunks.push_back(new Slot[CHUNK_SIZE]);
+			m_numUsed = 0;
+		}
+		return &m_chunks.back()[m_numUsed++];
+	}
+
+	void Free(T* object)
+	{
+		object->~T();
+		Slot* slot = (Slot*)object;
+		slot->m_next = m_freeList;
+		m_freeList = slot;
+	}
+
+private:
+	enum { CHUNK_SIZE = 256 };
+	union Slot {
+		char    m_object[sizeof(T)];
+		Slot   *m_next;
+		double  m_align;
+	};
+
+	NvPool(const NvPool&);
+	NvPool& operator=(const NvPool&);
+
+	std::vector<Slot*> m_chunks;
+	int                m_numUsed;   // slots handed out from the last chunk
+	Slot              *m_freeList;
+};
+
+// The per-vertex edge lists, plus an open-addressing hash keyed on the packed
+// vertex pair, so that finding the edge between two vertices is O(1) instead
+// of a walk down the list of a possibly high-valence vertex
+class NvEdgeInfoVec : public std::vector<NvEdgeInfo*> {
+public:
+	NvEdgeInfoVec() : m_hashMask(0), m_hashCount(0) {}
+
+	// sizes the hash for the given number of edges, dropping what it contained
+	void ReserveHash(int numEdges);
+	void InsertHash(NvEdgeInfo *edgeInfo);
+	NvEdgeInfo *FindHash(int v0, int v1) const;
+	inline bool HasHash() const { return m_hashMask != 0; }
+
+private:
+	struct HashEntry {
+		unsigned long long key;
+		NvEdgeInfo        *edgeInfo;
+	};
+
+	static inline unsigned long long PackKey(int v0, int v1)
+	{
+		unsigned int a = (unsigned int)v0, b = (unsigned int)v1;
+		if (a > b)
+			SWAP(a, b);
+		return ((unsigned long long)a << 32) | b;
+	}
+
+	std::vector<HashEntry> m_hash;
+	unsigned int           m_hashMask;
+	unsigned int           m_hashCount;
+};
+
+struct NvPools;
+class NvVertexUses;
+class NvFaceHits;
+class NvStripHits;
+
 // This is a summary of a strip that has been built
 class NvStripInfo {
 public:
@@ -125,17 +226,28 @@ public:
 	{
 		m_stripId      = stripId;
 		m_experimentId = experimentId;
+		m_marks        = NULL;
 		visited = false;
 		m_numDegenerates = 0;
 	}
 
 	// This is an experiment if the experiment id is >= 0
 	inline bool IsExperiment () const { return m_experimentId >= 0; }
+
+	// Experiments running on a worker thread keep their marks there, but fake faces are theirs alone
+	inline bool UsesMarks (const NvFaceInfo *faceInfo) const { return m_marks != NULL && faceInfo->m_faceIndex >= 0; }
 	  
 	inline bool IsInStrip (const NvFaceInfo *faceInfo) const 
 	{
 		if(faceInfo == NULL)
 			return false;
+
+		if(IsExperiment() && UsesMarks(faceInfo))
+		{
+			// strip ids are only unique within an experiment on worker threads
+			return m_marks->m_experimentId[faceInfo->m_faceIndex] == m_experimentId &&
+			       m_marks->m_testStripId[faceInfo->m_faceIndex] == m_stripId;
+		}
 		  
 		return (m_experimentId >= 0 ? faceInfo->m_testStripId == m_stripId : faceInfo->m_stripId == m_stripId);
 	}
@@ -153,13 +265,14 @@ public:
 	void MarkTriangle(NvFaceInfo *faceInfo);
 	  
 	// build the strip
-	void Build(NvEdgeInfoVec &edgeInfos, NvFaceInfoVec &faceInfos);
+	void Build(NvEdgeInfoVec &edgeInfos, NvFaceInfoVec &faceInfos, NvPools &pools);
 	  
 	// public data members
 	NvStripStartInfo m_startInfo;
 	NvFaceInfoVec    m_faces;
 	int              m_stripId;
 	int              m_experimentId;
+	NvExperimentMarks *m_marks;    // per-thread experiment marks, or NULL to mark the faces
 	  
 	bool visited;
 
@@ -169,6 +282,16 @@ public:
 typedef std::vector<NvStripInfo*>    NvStripInfoVec;
 
 
+// The pools one thread allocates from. All the pools of a stripifier go away
+// together, so an object can be freed to any of them, as long as that thread
+// is the only one using it at that time.
+struct NvPools {
+	NvPool<NvFaceInfo>  m_faces;
+	NvPool<NvEdgeInfo>  m_edges;
+	NvPool<NvStripInfo> m_strips;
+};
+
+
 //The actual stripifier
 class NvStripifier {
 public:
@@ -178,20 +301,25 @@ public:
 	~NvStripifier();
 	
 	//the target vertex cache size, the structure to place the strips in, and the input indices
-	void Stripify(const WordVec &in_indices, const int in_cacheSize, const int in_minStripLength, 
-				  const unsigned short maxIndex, NvStripInfoVec &allStrips, NvFaceInfoVec &allFaces);
+	//instantiated for unsigned short and unsigned int indices
+	template <class IndexType>
+	void Stripify(const IndexType* in_indices, const unsigned int in_numIndices, const int in_cacheSize, const int in_minStripLength, 
+				  const unsigned int maxIndex, NvStripInfoVec &allStrips, NvFaceInfoVec &allFaces);
 	void CreateStrips(const NvStripInfoVec& allStrips, IntVec& stripIndices, const bool bStitchStrips, unsigned int& numSeparateStrips, const bool bRestart, const unsigned int restartVal);
+
+	//the strips handed out by Stripify() are freed here, faces are freed with the stripifier
+	void FreeStrip(NvStripInfo* strip) { m_pools[0]->m_strips.Free(strip); }
 	
 	static int GetUniqueVertexInB(NvFaceInfo *faceA, NvFaceInfo *faceB);
 	//static int GetSharedVertex(NvFaceInfo *faceA, NvFaceInfo *faceB);
 	static void GetSharedVertices(NvFaceInfo *faceA, NvFaceInfo *faceB, int* vertex0, int* vertex1);
 
 	static bool IsDegenerate(const NvFaceInfo* face);
-	static bool IsDegenerate(const unsigned short v0, const unsigned short v1, const unsigned short v2);
+	static bool IsDegenerate(const unsigned int v0, const unsigned int v1, const unsigned int v2);
 	
 protected:
 	
-	WordVec indices;
+	std::vector<NvPools*> m_pools;  // the calling thread's first, then one per extra worker
 	int cacheSize;
 	int minStripLength;
 	float meshJump;
@@ -210,12 +338,13 @@ protected:
 	bool IsCW(NvFaceInfo *faceInfo, int v0, int v1);
 	bool NextIsCW(const int numIndices);
 	
-	static int  GetNextIndex(const WordVec &indices, NvFaceInfo *face);
+	static int  GetNextIndex(const IntVec &indices, NvFaceInfo *face);
 	static NvEdgeInfo *FindEdgeInfo(NvEdgeInfoVec &edgeInfos, int v0, int v1);
 	static NvFaceInfo *FindOtherFace(NvEdgeInfoVec &edgeInfos, int v0, int v1, NvFaceInfo *faceInfo);
 	NvFaceInfo *FindGoodResetPoint(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &edgeInfos);
 	
 	void FindAllStrips(NvStripInfoVec &allStrips, NvFaceInfoVec &allFaceInfos, NvEdgeInfoVec &allEdgeInfos, int numSamples);
+	static void BuildExperiment(unsigned int index, unsigned int worker, void* userData);
 	void SplitUpStripsAndOptimize(NvStripInfoVec &allStrips, NvStripInfoVec &outStrips, NvEdgeInfoVec& edgeInfos, NvFaceInfoVec& outFaceList);
 	void RemoveSmallStrips(NvStripInfoVec& allStrips, NvStripInfoVec& allBigStrips, NvFaceInfoVec& faceList);
 	
@@ -227,13 +356,13 @@ protected:
 	float AvgStripSize(const NvStripInfoVec &strips);
 	int FindStartPoint(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &edgeInfos);
 	
-	void UpdateCacheStrip(VertexCache* vcache, NvStripInfo* strip);
-	void UpdateCacheFace(VertexCache* vcache, NvFaceInfo* face);
-	float CalcNumHitsStrip(VertexCache* vcache, NvStripInfo* strip);
-	int CalcNumHitsFace(VertexCache* vcache, NvFaceInfo* face);
+	void UpdateCacheStrip(VertexCache* vcache, NvStripInfo* strip, const NvVertexUses& uses, NvStripHits& hits);
+	void UpdateCacheFace(VertexCache* vcache, NvFaceInfo* face, const NvVertexUses& uses, NvFaceHits& hits);
+	bool FirstFaceIsCW(NvStripInfo* strip);
 	int NumNeighbors(NvFaceInfo* face, NvEdgeInfoVec& edgeInfoVec);
 	
-	void BuildStripifyInfo(NvFaceInfoVec &faceInfos, NvEdgeInfoVec &edgeInfos, const unsigned short maxIndex);
+	template <class IndexType>
+	void BuildStripifyInfo(const IndexType* indices, const unsigned int numIndices, NvFaceInfoVec &faceInfos, NvEdgeInfoVec &edgeInfos, const unsigned int maxIndex);
 	bool AlreadyExists(NvFaceInfo* faceInfo, NvFaceInfoVec& faceInfos);
 	
 	// let our strip info classes and the other classes get
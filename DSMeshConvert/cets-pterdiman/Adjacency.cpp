@@ -20,8 +20,8 @@
 //#include "Stdafx.h"
 #include "Adjacency.h"
 #include "RevisitedRadix.h"
-#define RELEASEARRAY(x) { if ( x ) delete[] (x); }
-#define RELEASE(x) { if ( x ) delete (x); }
+#define RELEASEARRAY(x) { if ( x ) delete[] (x); (x) = 0; }
+#define RELEASE(x) { if ( x ) delete (x); (x) = 0; }
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //																	Adjacencies Class Implementation
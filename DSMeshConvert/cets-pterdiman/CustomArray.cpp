@@ -17,7 +17,7 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Constructor
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-CustomArray::CustomArray(unsigned long startsize, void* inputbuffer) : mNbPushedAddies(0), mNbAllocatedAddies(0), mBitCount(0), mBitMask(0), mAddresses(0), mCollapsed(0)
+CustomArray::CustomArray(unsigned long startsize, void* inputbuffer, bool contiguous) : mNbPushedAddies(0), mNbAllocatedAddies(0), mBitCount(0), mBitMask(0), mAddresses(0), mCollapsed(0), mContiguous(contiguous)
 {
 	// Initialize first export block
 	NewBlock(0, startsize);
@@ -35,7 +35,7 @@ CustomArray::CustomArray(unsigned long startsize, void* inputbuffer) : mNbPushed
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Constructor
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-CustomArray::CustomArray(const char* filename) : mNbPushedAddies(0), mNbAllocatedAddies(0), mBitCount(0), mBitMask(0), mAddresses(0), mCollapsed(0)
+CustomArray::CustomArray(const char* filename) : mNbPushedAddies(0), mNbAllocatedAddies(0), mBitCount(0), mBitMask(0), mAddresses(0), mCollapsed(0), mContiguous(false)
 {
 	// Catch the file's size to initialize first block
 	unsigned long StartSize = FileSize(filename);
@@ -119,6 +119,37 @@ CustomArray& CustomArray::NewBlock(CustomCell* previouscell, unsigned long size)
 	return *this;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A method to grow the single block of a contiguous array.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Input	:	bytesneeded		= #expected bytes
+// Output	:	-
+// Return	:	self-reference
+// Exception:	-
+// Remark	:	the block is at least doubled, so that n stores cost O(n) copies overall. Pushed addies and the last address are
+//				rebased into the new block.
+CustomArray& CustomArray::GrowBlock(unsigned long bytesneeded)
+{
+	CustomBlock& Block = mCurrentCell->Item;
+
+	unsigned long NewMax = Block.Max ? Block.Max*2 : CUSTOMARRAY_BLOCKSIZE;
+	while(NewMax < Block.Size + bytesneeded)	NewMax*=2;
+
+	u8* OldAddy = (u8*)Block.Addy;
+	u8* NewAddy = new u8[NewMax];
+	memcpy(NewAddy, OldAddy, Block.Size);
+
+	// Rebase addresses pointing into the old block
+	for(u32 i=0;i<mNbPushedAddies;i++)	mAddresses[i] = NewAddy + ((u8*)mAddresses[i] - OldAddy);
+	mLastAddress = NewAddy + ((u8*)mLastAddress - OldAddy);
+
+	RELEASEARRAY(OldAddy);
+	Block.Addy	= (void*)NewAddy;
+	Block.Max	= NewMax;
+
+	return *this;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // A method to check whether there's enough room in current block for expected datas, or not.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -126,11 +157,15 @@ CustomArray& CustomArray::NewBlock(CustomCell* previouscell, unsigned long size)
 // Output	:	-
 // Return	:	self-reference
 // Exception:	-
-// Remark	:	a new block is created if there's no more space left in current block.
+// Remark	:	a new block is created if there's no more space left in current block. Contiguous arrays grow their single block instead.
 CustomArray& CustomArray::CheckArray(unsigned long bytesneeded)
 {
 	unsigned long ExpectedSize = mCurrentCell->Item.Size + bytesneeded;
-	if(ExpectedSize > mCurrentCell->Item.Max)	NewBlock(mCurrentCell);
+	if(ExpectedSize > mCurrentCell->Item.Max)
+	{
+		if(mContiguous)	GrowBlock(bytesneeded);
+		else			NewBlock(mCurrentCell);
+	}
 	// I assume there IS enough room in the new block for expected data. It should always be the case since 'bytesneeded' is not supposed to be larger than 8
 	// (i.e. sizeof(double))
 	return *this;
@@ -284,11 +319,21 @@ CustomArray& CustomArray::LinkTo(CustomArray* array)
 // Exception:	-
 // Remark	:	if you provide your destination buffer original bytes are copied into it, then it's safe using them.
 //				if you don't, returned address is valid until the array's destructor is called. Beware of memory corruption...
+//				contiguous arrays return their own block when no buffer is provided, it stays valid until the next store.
 void* CustomArray::Collapse(void* userbuffer)
 {
 	// Fill possible remaining bits with 0
 	EndBits();
 
+	// Contiguous arrays already are a single buffer
+	if(mContiguous)
+	{
+		mNbPushedAddies=0;
+		if(!userbuffer)	return mInitCell->Item.Size ? mInitCell->Item.Addy : 0;
+		memcpy(userbuffer, mInitCell->Item.Addy, mInitCell->Item.Size);
+		return userbuffer;
+	}
+
 	char* Addy;
 	CustomCell* p = mInitCell;
 
@@ -463,31 +508,6 @@ CustomArray& CustomArray::Store(short w)
 	return *this;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// A method to store an unsigned short.
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Input	:	w		= unsigned short to store.
-// Output	:	-
-// Return	:	self-reference
-// Exception:	-
-// Remark	:	-
-CustomArray& CustomArray::Store(unsigned short w)
-{
-	// Fill possible remaining bits with 0
-	EndBits();
-
-	CheckArray(sizeof(unsigned short));
-
-	char* CurrentAddy = (char*)mCurrentCell->Item.Addy;
-	CurrentAddy+=mCurrentCell->Item.Size;
-
-	unsigned short* Current = (unsigned short*)CurrentAddy;
-	*Current=w;
-	mLastAddress = (void*)Current;
-	mCurrentCell->Item.Size+=sizeof(unsigned short);
-	return *this;
-}
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // A method to store a long.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -563,31 +583,6 @@ CustomArray& CustomArray::Store(int d)
 	return *this;
 }
 */
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// A method to store an unsigned int.
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Input	:	d		= unsigned int to store.
-// Output	:	-
-// Return	:	self-reference
-// Exception:	-
-// Remark	:	-
-CustomArray& CustomArray::Store(unsigned int d)
-{
-	// Fill possible remaining bits with 0
-	EndBits();
-
-	CheckArray(sizeof(unsigned int));
-
-	char* CurrentAddy = (char*)mCurrentCell->Item.Addy;
-	CurrentAddy+=mCurrentCell->Item.Size;
-
-	unsigned int* Current = (unsigned int*)CurrentAddy;
-	*Current=d;
-	mLastAddress = (void*)Current;
-	mCurrentCell->Item.Size+=sizeof(unsigned int);
-	return *this;
-}
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // A method to store a float.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
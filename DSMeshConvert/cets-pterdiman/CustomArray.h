@@ -154,6 +154,9 @@
 //
 //					- THIS IS NOT THREAD-SAFE.
 //
+//					- a CustomArray created with contiguous=true keeps a single block and doubles it in place when it's full. Collapse() then
+//					  returns the block itself (no copy) and Store() is a pointer bump. Pushed addies are rebased when the block moves.
+//
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -171,8 +174,8 @@ typedef int	BOOL;
 #include "../types.h"
 #include <stdio.h>
 #define CUSTOMARRAY_BLOCKSIZE	(4*1024)		// 4 Kb => heap size
-#define RELEASEARRAY(x) { if ( x ) delete[] (x); }
-#define RELEASE(x) { if ( x ) delete (x); }
+#define RELEASEARRAY(x) { if ( x ) delete[] (x); (x) = 0; }
+#define RELEASE(x) { if ( x ) delete (x); (x) = 0; }
 
 	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	//
@@ -210,17 +213,33 @@ private:
 	unsigned short			mNbAllocatedAddies;			// #allocated addies
 	unsigned char			mBitCount;
 	unsigned char			mBitMask;
+	bool					mContiguous;				// Single block, grown in place
 
 	// Management methods
 	CustomArray&			CheckArray(unsigned long bytesneeded);
 	CustomArray&			NewBlock(CustomCell* previouscell, unsigned long size=0);
+	CustomArray&			GrowBlock(unsigned long bytesneeded);
 	bool					SaveCell(CustomCell* p, FILE* fp);
 	CustomArray&			StoreASCIICode(char code);
 	// Helpers
 	u32					FileSize(const char* name);
+	template<class T>
+	inline	CustomArray&	StoreInline(T value)
+	{
+		// Fill possible remaining bits with 0
+		if(mBitCount)	EndBits();
+
+		if(mCurrentCell->Item.Size+sizeof(T) > mCurrentCell->Item.Max)	CheckArray(sizeof(T));
+
+		T* Current = (T*)((char*)mCurrentCell->Item.Addy + mCurrentCell->Item.Size);
+		*Current=value;
+		mLastAddress = (void*)Current;
+		mCurrentCell->Item.Size+=sizeof(T);
+		return *this;
+	}
 public:
 	// Constructor / destructor
-	CustomArray(unsigned long startsize=CUSTOMARRAY_BLOCKSIZE, void* inputbuffer=0);
+	CustomArray(unsigned long startsize=CUSTOMARRAY_BLOCKSIZE, void* inputbuffer=0, bool contiguous=false);
 	CustomArray(const char* filename);
 	~CustomArray();
 
@@ -233,11 +252,11 @@ public:
 	CustomArray&			Store(char b);
 	CustomArray&			Store(unsigned char b);
 	CustomArray&			Store(short w);
-	CustomArray&			Store(unsigned short w);
+	CustomArray&			Store(unsigned short w)	{ return StoreInline(w);	}
 	CustomArray&			Store(long d);
 	CustomArray&			Store(unsigned long d);
 //	CustomArray&			Store(int d);
-	CustomArray&			Store(unsigned int d);
+	CustomArray&			Store(unsigned int d)	{ return StoreInline(d);	}
 	CustomArray&			Store(float f);
 	CustomArray&			Store(double f);
 	CustomArray&			Store(const char* String);
@@ -261,6 +280,7 @@ public:
 	bool					ExportToDisk(FILE* fp);
 
 	unsigned long			GetOffset();
+	bool					IsContiguous()	const	{ return mContiguous;	}
 	CustomArray&			Padd();
 	CustomArray&			LinkTo(CustomArray* array);
 	void*					GetAddress()	{ char* CurrentAddy = (char*)mCurrentCell->Item.Addy; CurrentAddy+=mCurrentCell->Item.Size; return CurrentAddy; }
@@ -29,7 +29,7 @@ To do:
 //#include "Stdafx.h"
 #include "RevisitedRadix.h"
 #include <string.h>
-#define RELEASEARRAY(x) { if ( x ) delete[] (x); }
+#define RELEASEARRAY(x) { if ( x ) delete[] (x); (x) = 0; }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -102,9 +102,9 @@ bool Striper::Compute(STRIPERRESULT& result)
 	// You must call Init() first
 	if(!mAdj)	return false;
 
-	// Get some bytes
-	mStripLengths			= new CustomArray;				if(!mStripLengths)	return false;
-	mStripRuns				= new CustomArray;				if(!mStripRuns)		return false;
+	// Get some bytes. Contiguous arrays collapse without copying, so the results point straight into them
+	mStripLengths			= new CustomArray(CUSTOMARRAY_BLOCKSIZE, 0, true);	if(!mStripLengths)	return false;
+	mStripRuns				= new CustomArray(CUSTOMARRAY_BLOCKSIZE, 0, true);	if(!mStripRuns)		return false;
 	mTags					= new bool[mAdj->mNbFaces];		if(!mTags)			return false;
 	u32* Connectivity	= new u32[mAdj->mNbFaces];	if(!Connectivity)	return false;
 
@@ -355,7 +355,7 @@ u32 Striper::TrackStrip(u32 face, u32 oldest, u32 middle, u32* strip, u32* faces
 // Remark	:	-
 bool Striper::ConnectAllStrips(STRIPERRESULT& result)
 {
-	mSingleStrip = new CustomArray;
+	mSingleStrip = new CustomArray(CUSTOMARRAY_BLOCKSIZE, 0, true);
 	if(!mSingleStrip) return false;
 
 	mTotalLength	= 0;
@@ -0,0 +1,89 @@
+#include "chunking.h"
+#include <string.h>
+
+// Parameter words of each geometry command, 0xFF for the ones which don't exist
+static const u8 nbParameters[256] =
+{
+	// 0x00: no-operation
+	0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	// 0x10: matrix mode, push, pop, store, restore, identity, load 4x4 and 4x3, multiply 4x4, 4x3
+	// and 3x3, scale, translate
+	1, 0, 1, 1, 1, 0, 16, 12, 16, 12, 9, 3, 3, 0xFF, 0xFF, 0xFF,
+	// 0x20: color, normal, texture coordinates, the 6 vertex formats, polygon and texture
+	// attributes, palette
+	1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0xFF, 0xFF, 0xFF, 0xFF,
+	// 0x30: material colors, light vector and color, shininess
+	1, 1, 1, 1, 32, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	// 0x40: begin and end primitives
+	1, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	// 0x50: swap buffers
+	1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	// 0x60: viewport
+	1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	// 0x70: box, position and vector tests
+	3, 2, 1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+u32 GetPacketSize(const u32* list, u32 nbWords)
+{
+	if ( nbWords == 0 )
+		return 0;
+
+	u32 size = 1;
+	for ( u32 i = 0 ; i < 4 ; i++ )
+	{
+		u32 nb = nbParameters[(list[0] >> (i * 8)) & 0xFF];
+		if ( nb == 0xFF )
+			return 0;
+		size += nb;
+	}
+	return size <= nbWords ? size : 0;
+}
+
+bool ChunkDisplayList(const std::vector<u32>& list, u32 maxSize, std::vector<u32>& chunked)
+{
+	// packets go into the current chunk until the next one doesn't fit
+	std::vector<ChunkEntry> chunks;
+	u32 maxWords = (maxSize & ~(CHUNK_ALIGNMENT - 1)) / sizeof(u32);
+	for ( u32 i = 0 ; i < list.size() ; )
+	{
+		u32 packet = GetPacketSize(&list[i], list.size() - i);
+		if ( packet == 0 || packet > maxWords )
+			return false;
+
+		if ( chunks.empty() || chunks.back().size / sizeof(u32) + packet > maxWords )
+		{
+			ChunkEntry chunk = { i * sizeof(u32), 0 };
+			chunks.push_back(chunk);
+		}
+		chunks.back().size += packet * sizeof(u32);
+		i += packet;
+	}
+
+	// from their offsets in list to those in chunked
+	u32 offset = AlignChunkOffset(sizeof(ChunkHeader) + chunks.size() * sizeof(ChunkEntry));
+	std::vector<u32> sources(chunks.size());
+	for ( u32 c = 0 ; c < chunks.size() ; c++ )
+	{
+		sources[c] = chunks[c].offset / sizeof(u32);
+		chunks[c].offset = offset;
+		offset = AlignChunkOffset(offset + chunks[c].size);
+	}
+
+	ChunkHeader header = { CHUNK_MAGIC, chunks.size() };
+	chunked.assign(offset / sizeof(u32), 0);
+	memcpy(&chunked[0], &header, sizeof(header));
+	if ( ! chunks.empty() )
+		memcpy(&chunked[sizeof(header) / sizeof(u32)], &chunks[0], chunks.size() * sizeof(ChunkEntry));
+	for ( u32 c = 0 ; c < chunks.size() ; c++ )
+		memcpy(&chunked[chunks[c].offset / sizeof(u32)], &list[sources[c]], chunks[c].size);
+	return true;
+}
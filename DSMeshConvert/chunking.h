@@ -0,0 +1,17 @@
+#ifndef _CHUNKING_H_
+#define _CHUNKING_H_
+
+#include <vector>
+#include "types.h"
+#include "chunks.h"
+
+// Words taken by the command packet starting at list[0], its command word included, or 0 if
+// it has an unknown command or goes past nbWords
+u32 GetPacketSize(const u32* list, u32 nbWords);
+
+// Splits list into chunks of whole packets of maxSize bytes at most, padding included, laid
+// out as described in chunks.h. Returns false if a packet is bigger than maxSize or can't be
+// read
+bool ChunkDisplayList(const std::vector<u32>& list, u32 maxSize, std::vector<u32>& chunked);
+
+#endif // _CHUNKING_H_
@@ -0,0 +1,34 @@
+#ifndef _CHUNKS_H_
+#define _CHUNKS_H_
+
+#include "types.h"
+
+// A chunked display list is split into chunks of whole command packets, a command word and
+// its parameters, for the runtime to send each one to the geometry FIFO by DMA without cutting
+// a packet in two. It's a ChunkHeader, then nbChunks ChunkEntry, then the chunks, each one
+// starting at a multiple of CHUNK_ALIGNMENT bytes from the start of the list so that it's on
+// cache lines of its own. The padding is zero, which the FIFO reads as no-operations.
+// Everything is little-endian.
+
+static const u32 CHUNK_MAGIC = 'D' | ('S' << 8) | ('M' << 16) | ('C' << 24);
+static const u32 CHUNK_ALIGNMENT = 32;
+
+struct ChunkHeader
+{
+	u32 magic;
+	u32 nbChunks;
+};
+
+struct ChunkEntry
+{
+	u32 offset;		// of the chunk, from the start of the list
+	u32 size;		// of the chunk, in bytes, without its padding
+};
+
+// Offset rounded up to the next chunk
+inline u32 AlignChunkOffset(u32 offset)
+{
+	return (offset + CHUNK_ALIGNMENT - 1) & ~(CHUNK_ALIGNMENT - 1);
+}
+
+#endif // _CHUNKS_H_
@@ -0,0 +1,398 @@
+#include "compress.h"
+#include <queue>
+#include <algorithm>
+#include "thread.h"
+
+static const u32 MAX_SIZE = 0xFFFFFF;	// the header has 24 bits for it
+
+static void PushHeader(std::vector<u8>& out, CompressionType type, u32 size)
+{
+	out.push_back(u8(type));
+	out.push_back(u8(size));
+	out.push_back(u8(size >> 8));
+	out.push_back(u8(size >> 16));
+}
+
+static void PadToWord(std::vector<u8>& out)
+{
+	while ( out.size() % 4 != 0 )
+		out.push_back(0);
+}
+
+// LZ77 copies go from 3 to 18 bytes, from up to 4096 bytes back. They start 2 bytes back at
+// least, as the decompressors writing to VRAM 16 bits at a time need
+static const u32 LZ_MIN_LENGTH = 3;
+static const u32 LZ_MAX_LENGTH = 18;
+static const u32 LZ_MIN_DISTANCE = 2;
+static const u32 LZ_MAX_DISTANCE = 4096;
+static const u32 LZ_HASH_SIZE = 1 << 12;
+static const u32 LZ_MAX_CHAIN = 256;		// candidates tried per position
+
+static u32 HashLz(const u8* p)
+{
+	return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & (LZ_HASH_SIZE - 1);
+}
+
+// Finds the longest copy at every position through hash chains of the window, then parses
+// from the end for the fewest bits: 9 for a literal and its flag, 17 for a copy and its flag.
+// A copy can be cut short, so every length up to the longest one is tried
+static bool CompressLz77(const u8* data, u32 size, std::vector<u8>& out)
+{
+	std::vector<u8> lengths(size, 0);
+	std::vector<u16> distances(size, 0);
+	std::vector<s32> heads(LZ_HASH_SIZE, -1);
+	std::vector<s32> previous(size, -1);
+	for ( u32 i = 0 ; i + LZ_MIN_LENGTH <= size ; i++ )
+	{
+		u32 hash = HashLz(&data[i]);
+		u32 maxLength = std::min(LZ_MAX_LENGTH, size - i);
+		u32 best = 0;
+		u32 chain = 0;
+		for ( s32 j = heads[hash] ; j >= 0 && i - j <= LZ_MAX_DISTANCE && chain < LZ_MAX_CHAIN ; j = previous[j], chain++ )
+		{
+			if ( i - j < LZ_MIN_DISTANCE )
+				continue;
+			u32 length = 0;
+			while ( length < maxLength && data[j + length] == data[i + length] )
+				length++;
+			if ( length > best )
+			{
+				best = length;
+				distances[i] = u16(i - j);
+				if ( length == maxLength )
+					break;
+			}
+		}
+		previous[i] = heads[hash];
+		heads[hash] = i;
+		if ( best >= LZ_MIN_LENGTH )
+			lengths[i] = u8(best);
+	}
+
+	std::vector<u32> costs(size + 1, 0);
+	std::vector<u8> choices(size, 0);		// length of the copy starting there, 0 for a literal
+	for ( u32 i = size ; i-- > 0 ; )
+	{
+		costs[i] = 9 + costs[i + 1];
+		for ( u32 length = LZ_MIN_LENGTH ; length <= lengths[i] ; length++ )
+		{
+			if ( 17 + costs[i + length] <= costs[i] )
+			{
+				costs[i] = 17 + costs[i + length];
+				choices[i] = u8(length);
+			}
+		}
+	}
+
+	PushHeader(out, COMPRESSION_LZ77, size);
+	u32 flags = 0;
+	u32 nbBlocks = 8;
+	for ( u32 i = 0 ; i < size ; )
+	{
+		if ( nbBlocks == 8 )
+		{
+			flags = out.size();
+			out.push_back(0);
+			nbBlocks = 0;
+		}
+
+		if ( choices[i] == 0 )
+		{
+			out.push_back(data[i]);
+			i++;
+		}
+		else
+		{
+			u32 length = choices[i] - LZ_MIN_LENGTH;
+			u32 distance = distances[i] - 1;
+			out[flags] |= 0x80 >> nbBlocks;
+			out.push_back(u8((length << 4) | (distance >> 8)));
+			out.push_back(u8(distance));
+			i += choices[i];
+		}
+		nbBlocks++;
+	}
+	PadToWord(out);
+	return true;
+}
+
+// RLE runs go from 3 to 130 repeated bytes, and from 1 to 128 bytes as they are
+static bool CompressRle(const u8* data, u32 size, std::vector<u8>& out)
+{
+	PushHeader(out, COMPRESSION_RLE, size);
+	u32 literals = 0;	// start of the bytes waiting to go as they are
+	for ( u32 i = 0 ; i <= size ; )
+	{
+		u32 run = 1;
+		while ( i < size && i + run < size && run < 130 && data[i + run] == data[i] )
+			run++;
+
+		if ( i == size || run >= 3 || i - literals == 128 )
+		{
+			for ( ; literals < i ; literals += 128 )
+			{
+				u32 count = std::min(i - literals, 128u);
+				out.push_back(u8(count - 1));
+				out.insert(out.end(), data + literals, data + literals + count);
+			}
+			literals = i;
+		}
+		if ( i == size )
+			break;
+
+		if ( run >= 3 )
+		{
+			out.push_back(u8(0x80 | (run - 3)));
+			out.push_back(data[i]);
+			i += run;
+			literals = i;
+		}
+		else
+		{
+			i++;
+		}
+	}
+	PadToWord(out);
+	return true;
+}
+
+struct HuffmanNode
+{
+	u32 frequency;
+	u32 children[2];	// NO_CHILD for a symbol
+	u32 symbol;
+	u32 nbNodes;		// nodes which aren't symbols in its subtree, itself included
+};
+
+static const u32 NO_CHILD = 0xFFFFFFFF;
+
+// Orders (frequency, node) pairs for the least frequent to come first out of a priority queue
+struct HuffmanLess
+{
+	bool operator()(const std::pair<u32, u32>& a, const std::pair<u32, u32>& b) const
+	{
+		return a > b;
+	}
+};
+
+// A node waiting for its children to be placed in the tree
+struct HuffmanSlot
+{
+	u32 deadline;		// last pair the children can go to
+	u32 node;
+	u32 position;		// of the node in the tree
+	u32 pair;			// of the node, for the offset to its children
+	u32 nbNodes;
+
+	bool operator<(const HuffmanSlot& s) const { return deadline < s.deadline || (deadline == s.deadline && nbNodes < s.nbNodes); }
+};
+
+static bool CompressHuffman(CompressionType type, const u8* data, u32 size, std::vector<u8>& out)
+{
+	u32 bits = type & 0xF;
+	u32 nbSymbols = 1 << bits;
+	std::vector<u32> symbols;
+	for ( u32 i = 0 ; i < size ; i++ )
+	{
+		if ( bits == 8 )
+		{
+			symbols.push_back(data[i]);
+		}
+		else
+		{
+			symbols.push_back(data[i] & 0xF);
+			symbols.push_back(data[i] >> 4);
+		}
+	}
+
+	std::vector<HuffmanNode> nodes;
+	std::priority_queue<std::pair<u32, u32>, std::vector<std::pair<u32, u32> >, HuffmanLess> queue;
+	std::vector<u32> frequencies(nbSymbols, 0);
+	for ( u32 i = 0 ; i < symbols.size() ; i++ )
+		frequencies[symbols[i]]++;
+	for ( u32 s = 0 ; s < nbSymbols ; s++ )
+	{
+		// the root needs two children, even for data made of a single symbol
+		if ( frequencies[s] > 0 || (queue.size() < 2 && s + 2 - queue.size() >= nbSymbols) )
+		{
+			HuffmanNode leaf = { frequencies[s], { NO_CHILD, NO_CHILD }, s, 0 };
+			queue.push(std::make_pair(leaf.frequency, nodes.size()));
+			nodes.push_back(leaf);
+		}
+	}
+	while ( queue.size() > 1 )
+	{
+		std::pair<u32, u32> a = queue.top(); queue.pop();
+		std::pair<u32, u32> b = queue.top(); queue.pop();
+		HuffmanNode node = { a.first + b.first, { a.second, b.second }, 0, 1 + nodes[a.second].nbNodes + nodes[b.second].nbNodes };
+		queue.push(std::make_pair(node.frequency, nodes.size()));
+		nodes.push_back(node);
+	}
+	u32 root = queue.top().second;
+
+	// Children go in pairs after the root, the ones of a node at most 64 pairs after its own.
+	// Placing the earliest deadline first alone runs out of pairs on balanced trees, as the
+	// nodes waiting pile up: the smallest subtree goes first instead, which keeps them few,
+	// unless a deadline can't wait anymore
+	std::vector<u8> tree(1, 0);
+	std::vector<HuffmanSlot> waiting;
+	HuffmanSlot first = { 63, root, 0, 0, nodes[root].nbNodes };
+	waiting.push_back(first);
+	for ( u32 pair = 0 ; ! waiting.empty() ; pair++ )
+	{
+		// the new nodes have the latest deadlines, so the waiting ones are in time if each one
+		// can go after those with an earlier deadline
+		std::sort(waiting.begin(), waiting.end());
+		bool urgent = false;
+		for ( u32 i = 0 ; i < waiting.size() ; i++ )
+		{
+			if ( waiting[i].deadline < pair + i )
+				return false;
+			urgent = urgent || waiting[i].deadline == pair + i;
+		}
+		u32 next = 0;
+		for ( u32 i = 1 ; i < waiting.size() && ! urgent ; i++ )
+		{
+			if ( waiting[i].nbNodes < waiting[next].nbNodes )
+				next = i;
+		}
+		HuffmanSlot slot = waiting[next];
+		waiting.erase(waiting.begin() + next);
+
+		// the root isn't in a pair, its children can't go before pair 0
+		tree[slot.position] = u8(slot.position == 0 ? pair : pair - slot.pair - 1);
+		for ( u32 c = 0 ; c < 2 ; c++ )
+		{
+			u32 child = nodes[slot.node].children[c];
+			u32 position = tree.size();
+			if ( nodes[child].children[0] == NO_CHILD )
+			{
+				tree[slot.position] |= 0x80 >> c;
+				tree.push_back(u8(nodes[child].symbol));
+			}
+			else
+			{
+				tree.push_back(0);
+				HuffmanSlot childSlot = { pair + 64, child, position, pair, nodes[child].nbNodes };
+				waiting.push_back(childSlot);
+			}
+		}
+	}
+
+	// codes from the root down, the bit of child 1 being set
+	std::vector<std::vector<u8> > codes(nbSymbols);
+	std::vector<std::pair<u32, std::vector<u8> > > stack(1, std::make_pair(root, std::vector<u8>()));
+	while ( ! stack.empty() )
+	{
+		std::pair<u32, std::vector<u8> > top = stack.back();
+		stack.pop_back();
+		const HuffmanNode& node = nodes[top.first];
+		if ( node.children[0] == NO_CHILD )
+		{
+			codes[node.symbol] = top.second;
+			continue;
+		}
+		for ( u32 c = 0 ; c < 2 ; c++ )
+		{
+			stack.push_back(std::make_pair(node.children[c], top.second));
+			stack.back().second.push_back(u8(c));
+		}
+	}
+
+	// the size byte counts 2 bytes per unit, with the root and itself, so that the codes
+	// start on a word
+	u32 treeUnits = (tree.size() + 1 + 1) / 2;
+	if ( treeUnits % 2 != 0 )
+		treeUnits++;
+	if ( treeUnits > 256 )
+		return false;
+
+	PushHeader(out, type, size);
+	out.push_back(u8(treeUnits - 1));
+	out.insert(out.end(), tree.begin(), tree.end());
+	out.resize(4 + treeUnits * 2, 0);
+
+	u32 word = 0;
+	u32 nbBits = 0;
+	for ( u32 i = 0 ; i < symbols.size() ; i++ )
+	{
+		const std::vector<u8>& code = codes[symbols[i]];
+		for ( u32 b = 0 ; b < code.size() ; b++ )
+		{
+			word |= code[b] << (31 - nbBits);
+			if ( ++nbBits == 32 )
+			{
+				for ( u32 k = 0 ; k < 4 ; k++ )
+					out.push_back(u8(word >> (k * 8)));
+				word = 0;
+				nbBits = 0;
+			}
+		}
+	}
+	if ( nbBits > 0 )
+	{
+		for ( u32 k = 0 ; k < 4 ; k++ )
+			out.push_back(u8(word >> (k * 8)));
+	}
+	return true;
+}
+
+bool Compress(CompressionType type, const u8* data, u32 size, std::vector<u8>& out)
+{
+	out.clear();
+	if ( size > MAX_SIZE )
+		return false;
+
+	switch ( type )
+	{
+	case COMPRESSION_LZ77:
+		return CompressLz77(data, size, out);
+	case COMPRESSION_HUFFMAN4:
+	case COMPRESSION_HUFFMAN8:
+		return CompressHuffman(type, data, size, out);
+	case COMPRESSION_RLE:
+		return CompressRle(data, size, out);
+	default:
+		return false;
+	}
+}
+
+struct CompressionContext
+{
+	const CompressionType* types;
+	const u8* data;
+	u32 size;
+	std::vector<std::vector<u8> > outputs;
+	std::vector<u8> done;		// not bool, the threads set them at once
+};
+
+static void CompressJob(u32 index, u32 /*worker*/, void* userData)
+{
+	CompressionContext& context = *(CompressionContext*)userData;
+	context.done[index] = Compress(context.types[index], context.data, context.size, context.outputs[index]);
+}
+
+CompressionType CompressSmallest(const CompressionType* types, u32 nbTypes, const u8* data, u32 size, std::vector<u8>& out)
+{
+	CompressionContext context;
+	context.types = types;
+	context.data = data;
+	context.size = size;
+	context.outputs.resize(nbTypes);
+	context.done.resize(nbTypes, 0);
+
+	ThreadPool pool(std::min(nbTypes, GetNbProcessors()));
+	pool.Run(nbTypes, CompressJob, &context);
+
+	u32 best = nbTypes;
+	for ( u32 i = 0 ; i < nbTypes ; i++ )
+	{
+		if ( context.done[i] && (best == nbTypes || context.outputs[i].size() < context.outputs[best].size()) )
+			best = i;
+	}
+	if ( best == nbTypes )
+		return COMPRESSION_NONE;
+
+	out.swap(context.outputs[best]);
+	return types[best];
+}
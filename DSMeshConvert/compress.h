@@ -0,0 +1,27 @@
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <vector>
+#include "types.h"
+
+// Formats of the DS BIOS decompressors (SWI 0x11 to 0x15), as the first byte of their
+// header: the type in the high nibble, and the bits per symbol for Huffman in the low one.
+// The other 3 bytes of the header hold the decompressed size
+enum CompressionType
+{
+	COMPRESSION_NONE = 0x00,
+	COMPRESSION_LZ77 = 0x10,
+	COMPRESSION_HUFFMAN4 = 0x24,
+	COMPRESSION_HUFFMAN8 = 0x28,
+	COMPRESSION_RLE = 0x30,
+};
+
+// Compresses size bytes of data into out in the format of type, padded to a multiple of
+// 4 bytes. Returns false if the format can't hold data
+bool Compress(CompressionType type, const u8* data, u32 size, std::vector<u8>& out);
+
+// Compresses data in each of the nbTypes formats of types at once, on several threads, and
+// keeps the smallest in out. Returns its type, or COMPRESSION_NONE if none could hold data
+CompressionType CompressSmallest(const CompressionType* types, u32 nbTypes, const u8* data, u32 size, std::vector<u8>& out);
+
+#endif // _COMPRESS_H_
@@ -0,0 +1,155 @@
+#include "decompress.h"
+
+static u32 GetDecompressedSize(const u8* data)
+{
+	return data[1] | (data[2] << 8) | (data[3] << 16);
+}
+
+bool IsCompressed(const u8* data, u32 size)
+{
+	return size >= 4 && (data[0] == 0x10 || data[0] == 0x24 || data[0] == 0x28 || data[0] == 0x30);
+}
+
+// Blocks of 8 literals or copies, a flag byte giving the kind of each one from bit 7 down.
+// A copy is 2 bytes: 3 less than its length in the high nibble, then 1 less than how far back
+// it copies from in 12 bits
+static bool DecompressLz77(const u8* data, u32 size, std::vector<u8>& out)
+{
+	u32 outSize = GetDecompressedSize(data);
+	u32 in = 4;
+	while ( out.size() < outSize )
+	{
+		if ( in >= size )
+			return false;
+		u8 flags = data[in++];
+		for ( u32 i = 0 ; i < 8 && out.size() < outSize ; i++, flags <<= 1 )
+		{
+			if ( (flags & 0x80) == 0 )
+			{
+				if ( in >= size )
+					return false;
+				out.push_back(data[in++]);
+				continue;
+			}
+
+			if ( in + 1 >= size )
+				return false;
+			u32 length = (data[in] >> 4) + 3;
+			u32 distance = (((data[in] & 0xF) << 8) | data[in + 1]) + 1;
+			in += 2;
+			if ( distance > out.size() )
+				return false;
+			for ( u32 j = 0 ; j < length && out.size() < outSize ; j++ )
+				out.push_back(out[out.size() - distance]);
+		}
+	}
+	return true;
+}
+
+// A tree of nodes, then the codes as 32-bit words read from bit 31 down. The byte after the
+// header is half the size of the tree, minus 1, and the root follows it. A node holds the
+// offset of its children, which are at (its address & ~1) + offset * 2 + 2, and whether
+// child 0 (bit 7) or child 1 (bit 6) is a symbol rather than another node
+static bool DecompressHuffman(const u8* data, u32 size, std::vector<u8>& out)
+{
+	u32 outSize = GetDecompressedSize(data);
+	u32 bits = data[0] & 0xF;
+	if ( size < 5 )
+		return false;
+	u32 treeEnd = 4 + (data[4] + 1) * 2;
+	u32 stream = treeEnd;
+
+	u32 node = 5;
+	u32 nibbles = 0;
+	u32 nbNibbles = 0;
+	while ( out.size() < outSize )
+	{
+		if ( stream + 4 > size )
+			return false;
+		u32 word = data[stream] | (data[stream + 1] << 8) | (data[stream + 2] << 16) | (data[stream + 3] << 24);
+		stream += 4;
+
+		for ( u32 i = 0 ; i < 32 && out.size() < outSize ; i++, word <<= 1 )
+		{
+			u32 bit = word >> 31;
+			u32 child = (node & ~1) + (data[node] & 0x3F) * 2 + 2 + bit;
+			bool isSymbol = (data[node] & (bit != 0 ? 0x40 : 0x80)) != 0;
+			if ( child >= treeEnd )
+				return false;
+			if ( ! isSymbol )
+			{
+				node = child;
+				continue;
+			}
+
+			node = 5;
+			if ( bits == 8 )
+			{
+				out.push_back(data[child]);
+				continue;
+			}
+
+			// 4-bit symbols fill the bytes from their low nibble
+			nibbles |= (data[child] & 0xF) << (nbNibbles * 4);
+			if ( ++nbNibbles == 2 )
+			{
+				out.push_back(u8(nibbles));
+				nibbles = 0;
+				nbNibbles = 0;
+			}
+		}
+	}
+	return true;
+}
+
+// Runs, each one after a flag byte: with bit 7 set, 3 more than the low bits times the byte
+// which follows, or else 1 more than the low bits bytes as they are
+static bool DecompressRle(const u8* data, u32 size, std::vector<u8>& out)
+{
+	u32 outSize = GetDecompressedSize(data);
+	u32 in = 4;
+	while ( out.size() < outSize )
+	{
+		if ( in >= size )
+			return false;
+		u8 flag = data[in++];
+		if ( flag & 0x80 )
+		{
+			if ( in >= size )
+				return false;
+			u32 length = (flag & 0x7F) + 3;
+			for ( u32 j = 0 ; j < length && out.size() < outSize ; j++ )
+				out.push_back(data[in]);
+			in++;
+		}
+		else
+		{
+			u32 length = (flag & 0x7F) + 1;
+			if ( in + length > size )
+				return false;
+			for ( u32 j = 0 ; j < length && out.size() < outSize ; j++ )
+				out.push_back(data[in + j]);
+			in += length;
+		}
+	}
+	return true;
+}
+
+bool Decompress(const u8* data, u32 size, std::vector<u8>& out)
+{
+	out.clear();
+	if ( ! IsCompressed(data, size) )
+		return false;
+
+	out.reserve(GetDecompressedSize(data));
+	switch ( data[0] & 0xF0 )
+	{
+	case 0x10:
+		return DecompressLz77(data, size, out);
+	case 0x20:
+		return DecompressHuffman(data, size, out);
+	case 0x30:
+		return DecompressRle(data, size, out);
+	}
+	return false;
+}
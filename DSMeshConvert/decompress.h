@@ -0,0 +1,15 @@
+#ifndef _DECOMPRESS_H_
+#define _DECOMPRESS_H_
+
+#include <vector>
+#include "types.h"
+
+// Whether data starts with the header of a format the DS BIOS decompresses
+// (LZ77 0x10, Huffman 0x24 and 0x28, RLE 0x30)
+bool IsCompressed(const u8* data, u32 size);
+
+// Decompresses data the way the DS BIOS does, into out. Returns false if data isn't in one
+// of its formats or is truncated
+bool Decompress(const u8* data, u32 size, std::vector<u8>& out);
+
+#endif // _DECOMPRESS_H_
@@ -1,8 +1,14 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <io.h>
+#include <string.h>
 #include <string>
 #include <vector>
 #include <map>
 #include <set>
+#include <algorithm>
+#include <functional>
 
 #include <assimp.hpp>
 #include <aiPostProcess.h>
@@ -12,14 +18,18 @@
 
 #include <aiVector3D.inl>
 
-//#define NVTRISTRIP // buggy?!!
-//#define CETS_PTERDIMAN // http://www.codercorner.com/Strips.htm // memory corruption...
-#define ACTC // http://plunk.org/~grantham/public/actc/
-#include "NvTriStrip.h"
-#include "cets-pterdiman/Striper.h"
-#include "ac/tc.h"
-
+#include "stripper.h"
+#include "primitives.h"
+#include "quads.h"
 #include "stripping.h"
+#include "optimizer.h"
+#include "stripcache.h"
+#include "prefetch.h"
+#include "packwriter.h"
+#include "simplify.h"
+#include "compress.h"
+#include "chunking.h"
+#include "thread.h"
 
 #include "types.h"
 
@@ -76,16 +86,260 @@ void PushValue(std::vector<u32>& list, u32& cmdOffset, u32& cmdIndex, u32 cmd, u
 	}
 }
 
-int Convert(const char* input, const char* output)
+// Directional lights and an ambient color, evaluated at conversion time like the DS
+// lighting does: ambient + sum of max(0, -direction . normal) * color
+struct LightRig
 {
-#ifdef NVTRISTRIP
-	// Configure NVTriStrip
-	SetStitchStrips(false);
-	SetCacheSize(64); // ds has no cache, give me longest strips possible ffs !
-#endif
+	struct Light
+	{
+		aiVector3D direction;	// where the light goes, in model space
+		aiColor3D color;
+	};
 
-	// Configure Assimp
-	Assimp::Importer importer;
+	std::vector<Light> lights;
+	aiColor3D ambient;
+
+	void AddLight(const aiVector3D& direction, const aiColor3D& color)
+	{
+		Light light;
+		light.direction = direction;
+		light.direction.Normalize();
+		light.color = color;
+		lights.push_back(light);
+	}
+
+	aiColor3D Evaluate(aiVector3D normal) const
+	{
+		normal.Normalize();
+		aiColor3D c = ambient;
+		for ( u32 i = 0 ; i < lights.size() ; i++ )
+		{
+			const aiVector3D& d = lights[i].direction;
+			float diffuse = -(d.x * normal.x + d.y * normal.y + d.z * normal.z);
+			if ( diffuse > 0.0f )
+			{
+				c.r += diffuse * lights[i].color.r;
+				c.g += diffuse * lights[i].color.g;
+				c.b += diffuse * lights[i].color.b;
+			}
+		}
+		return c;
+	}
+};
+
+// 5 bits per component, clamped
+u32 PackColor(float r, float g, float b)
+{
+	s32 c[3] = { (s32)(r * 31), (s32)(g * 31), (s32)(b * 31) };
+	for ( u32 i = 0 ; i < 3 ; i++ )
+	{
+		if ( c[i] < 0 ) c[i] = 0;
+		if ( c[i] > 31 ) c[i] = 31;
+	}
+	return c[0] | (c[1] << 5) | (c[2] << 10);
+}
+
+// Stages of a batch conversion, each one handing the files to the next
+enum BatchStage
+{
+	STAGE_READ,
+	STAGE_IMPORT,
+	STAGE_STRIP,
+	STAGE_EMIT,
+	NB_STAGES
+};
+
+struct Options
+{
+	Stripper* stripper;
+	float quadAngle;	// in degrees, negative for no quads
+	float optimizeTime;	// in seconds
+	bool tunnel;
+	bool honorWinding;	// keep the winding of every triangle, for back face culling
+	bool bakeLighting;	// colors lit by lightRig instead of normals
+	LightRig lightRig;
+	const char* cacheDirectory;	// 0 for no strip cache
+	u32 importFlags;			// Assimp post-processing steps
+	bool timings;
+	const char* batchList;		// file of "<input> <output>" lines to convert in a pipeline, 0 for none
+	u32 stageWorkers[NB_STAGES];		// threads of each pipeline stage
+	u32 queueSize;				// files waiting between two stages, at most
+	const char* packFile;		// pack getting all the meshes of the batch, 0 to write them one by one
+	std::vector<float> lodRatios;	// triangles of each level of detail below the full mesh, over the full mesh's
+	std::vector<CompressionType> compressions;	// formats tried on the display lists, none to keep them as they are
+	u32 chunkSize;				// of the chunks the display lists are split into at most, in bytes, 0 for none
+};
+
+// Strips triangles, then joins the strips and batches triangles where it makes the display list smaller
+bool GeneratePrimitives(const Options& options, const std::vector<u32>& triangles, const CostModel& cost, PrimitiveGroups& groups)
+{
+	PrimitiveGroups strips;
+	if ( ! options.stripper->Strip(triangles, strips) )
+		return false;
+
+	// whatever the stripper left reversed
+	if ( options.honorWinding )
+		EnforceWinding(strips, triangles);
+
+	StitchStrips(strips, cost);
+	BatchTriangles(strips, cost);
+	groups.Add(strips);
+	return true;
+}
+
+// Generates the primitives of mesh and improves them as the options say
+bool GenerateStrips(const aiMesh* mesh, const std::vector<u32>& indices, const CostModel& cost, const Options& options, PrimitiveGroups& strips)
+{
+	if ( ! GeneratePrimitives(options, indices, cost, strips) )
+		return false;
+	printf("%d primitives generated for %d triangles, %d bytes\n", strips.GetNbPrimitives(), indices.size() / 3, cost.GetCost(strips));
+
+	// Pair triangles into quads, strip the ones left and keep that if it's smaller
+	if ( options.quadAngle >= 0.0f )
+	{
+		PrimitiveGroups quads;
+		std::vector<u32> triangles;
+		BuildQuads(indices, &mesh->mVertices[0].x, options.quadAngle * float(AI_MATH_PI) / 180.0f, cost, quads, triangles);
+		if ( quads.GetNbPrimitives() > 0 && GeneratePrimitives(options, triangles, cost, quads) )
+		{
+			printf("%d primitives with quads, %d bytes\n", quads.GetNbPrimitives(), cost.GetCost(quads));
+			if ( cost.GetCost(quads) < cost.GetCost(strips) )
+				strips = quads;
+		}
+	}
+
+	if ( options.tunnel )
+	{
+		u32 saved = TunnelStrips(strips, indices, cost, options.honorWinding);
+		printf("Tunneling saved %d bytes, %d primitives\n", saved, strips.GetNbPrimitives());
+	}
+
+	if ( options.optimizeTime > 0.0f )
+	{
+		u32 startCost = cost.GetCost(strips);
+		u32 saved = OptimizeStrips(strips, indices, cost, options.optimizeTime, options.honorWinding);
+		printf("Optimizer saved %d bytes out of %d (%.1f%%), %d primitives\n", saved, startCost, startCost > 0 ? 100.0f * saved / startCost : 0.0f, strips.GetNbPrimitives());
+	}
+
+	return true;
+}
+
+struct ImportProfile
+{
+	const char* name;
+	u32 flags;
+};
+
+// Assimp post-processing steps to run on import. The DS has no vertex cache, and the strippers
+// make their own triangle order anyway
+static const ImportProfile importProfiles[] = {
+	{ "full",
+		aiProcess_FixInfacingNormals
+		| aiProcess_GenUVCoords
+		| aiProcess_TransformUVCoords
+		| aiProcess_JoinIdenticalVertices
+		| aiProcess_Triangulate
+		| aiProcess_PreTransformVertices
+		| aiProcess_FindDegenerates
+		| aiProcess_SortByPType
+		| aiProcess_FindInstances
+		| aiProcess_OptimizeMeshes
+		| aiProcess_ImproveCacheLocality
+		| aiProcess_RemoveComponent },
+	// without the steps which only reorder or share data the DS can't use
+	{ "lean",
+		aiProcess_FixInfacingNormals
+		| aiProcess_GenUVCoords
+		| aiProcess_TransformUVCoords
+		| aiProcess_JoinIdenticalVertices
+		| aiProcess_Triangulate
+		| aiProcess_PreTransformVertices
+		| aiProcess_FindDegenerates
+		| aiProcess_SortByPType
+		| aiProcess_OptimizeMeshes
+		| aiProcess_RemoveComponent },
+	// only what the conversion needs: triangles sharing their vertices in one space. Normals
+	// aren't fixed, UVs aren't generated, and meshes aren't joined
+	{ "fast",
+		aiProcess_JoinIdenticalVertices
+		| aiProcess_Triangulate
+		| aiProcess_PreTransformVertices
+		| aiProcess_SortByPType
+		| aiProcess_RemoveComponent },
+};
+static const u32 nbImportProfiles = sizeof(importProfiles) / sizeof(importProfiles[0]);
+
+struct CompressionProfile
+{
+	const char* name;
+	u32 nbTypes;
+	CompressionType types[4];
+};
+
+// Formats of the DS BIOS tried on the display lists, the smallest result being kept
+static const CompressionProfile compressionProfiles[] = {
+	{ "none", 0, { COMPRESSION_NONE } },
+	{ "lz77", 1, { COMPRESSION_LZ77 } },
+	{ "huffman", 2, { COMPRESSION_HUFFMAN4, COMPRESSION_HUFFMAN8 } },
+	{ "rle", 1, { COMPRESSION_RLE } },
+	{ "best", 4, { COMPRESSION_LZ77, COMPRESSION_HUFFMAN4, COMPRESSION_HUFFMAN8, COMPRESSION_RLE } },
+};
+static const u32 nbCompressionProfiles = sizeof(compressionProfiles) / sizeof(compressionProfiles[0]);
+
+struct ImportStep
+{
+	u32 flag;
+	const char* name;
+};
+
+static const ImportStep importSteps[] = {
+	{ aiProcess_RemoveComponent, "RemoveComponent" },
+	{ aiProcess_Triangulate, "Triangulate" },
+	{ aiProcess_SortByPType, "SortByPType" },
+	{ aiProcess_FindDegenerates, "FindDegenerates" },
+	{ aiProcess_PreTransformVertices, "PreTransformVertices" },
+	{ aiProcess_FindInstances, "FindInstances" },
+	{ aiProcess_OptimizeMeshes, "OptimizeMeshes" },
+	{ aiProcess_FixInfacingNormals, "FixInfacingNormals" },
+	{ aiProcess_GenUVCoords, "GenUVCoords" },
+	{ aiProcess_TransformUVCoords, "TransformUVCoords" },
+	{ aiProcess_JoinIdenticalVertices, "JoinIdenticalVertices" },
+	{ aiProcess_ImproveCacheLocality, "ImproveCacheLocality" },
+};
+static const u32 nbImportSteps = sizeof(importSteps) / sizeof(importSteps[0]);
+
+u32 GetMilliseconds(clock_t start)
+{
+	return u32((clock() - start) * 1000 / CLOCKS_PER_SEC);
+}
+
+// Imports input once without post-processing, then once more with every step of flags added to
+// the previous ones. A step costs the difference it makes, its effect on the other steps included
+void PrintImportTimings(Assimp::Importer& importer, const char* input, u32 flags)
+{
+	clock_t start = clock();
+	if ( importer.ReadFile(input, 0) == 0 )
+		return;
+	u32 previous = GetMilliseconds(start);
+	printf("Reading: %d ms\n", previous);
+
+	u32 steps = 0;
+	for ( u32 i = 0 ; i < nbImportSteps ; i++ )
+	{
+		if ( (flags & importSteps[i].flag) == 0 )
+			continue;
+
+		steps |= importSteps[i].flag;
+		start = clock();
+		importer.ReadFile(input, steps);
+		u32 total = GetMilliseconds(start);
+		printf("  %-24s %5d ms\n", importSteps[i].name, total > previous ? total - previous : 0);
+		previous = total;
+	}
+}
+
+void ConfigureImporter(Assimp::Importer& importer)
+{
 	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE,
 		aiPrimitiveType_POINT
 		| aiPrimitiveType_LINE);
@@ -104,21 +358,26 @@ int Convert(const char* input, const char* output)
 		| aiComponent_LIGHTS
 		| aiComponent_CAMERAS
 		| aiComponent_MATERIALS);
+}
 
-	// Import file
-	const aiScene* scene = importer.ReadFile(input,
-		aiProcess_FixInfacingNormals
-		| aiProcess_GenUVCoords
-		| aiProcess_TransformUVCoords
-		| aiProcess_JoinIdenticalVertices
-		| aiProcess_Triangulate
-		| aiProcess_PreTransformVertices
-		| aiProcess_FindDegenerates
-		| aiProcess_SortByPType
-		| aiProcess_FindInstances 
-		| aiProcess_OptimizeMeshes 
-		| aiProcess_ImproveCacheLocality
-		| aiProcess_RemoveComponent);
+// What a conversion made
+struct ConvertStats
+{
+	u32 nbTriangles;
+	u32 nbPrimitives;
+	u32 size;			// of the display list, in bytes
+};
+
+// Imports input, which has to hold a single mesh
+int ImportMesh(Assimp::Importer& importer, const char* input, const Options& options, const aiMesh*& mesh)
+{
+	if ( options.timings )
+		PrintImportTimings(importer, input, options.importFlags);
+
+	clock_t start = clock();
+	const aiScene* scene = importer.ReadFile(input, options.importFlags);
+	if ( options.timings )
+		printf("Import: %d ms\n", GetMilliseconds(start));
 
 	if ( scene == 0 )
 	{
@@ -133,7 +392,7 @@ int Convert(const char* input, const char* output)
 		return 2;
 	}
 
-	aiMesh* mesh = scene->mMeshes[0];
+	mesh = scene->mMeshes[0];
 
 	if ( mesh->mFaces->mNumIndices > 65535 )
 	{
@@ -141,111 +400,151 @@ int Convert(const char* input, const char* output)
 		return 3;
 	}
 
-	//std::vector<u32> indices;
-	//for ( u32 i = 0 ; i < mesh->mNumFaces ; i++ )
-	//{
-	//	ai_assert(mesh->mFaces[i].mNumIndices == 3);
-	//	indices.push_back(mesh->mFaces[i].mIndices[0]);
-	//	indices.push_back(mesh->mFaces[i].mIndices[1]);
-	//	indices.push_back(mesh->mFaces[i].mIndices[2]);
-	//}
+	return 0;
+}
+
+// Commands sent for each vertex of mesh
+u32 GetNbVertexCommands(const aiMesh* mesh, const Options& options)
+{
+	u32 nbVertexCommands = 1;
+	if ( mesh->HasTextureCoords(0) )
+		nbVertexCommands++;
+	if ( options.bakeLighting && mesh->HasNormals() )
+		nbVertexCommands++;
+	else if ( mesh->HasNormals() )
+		nbVertexCommands += mesh->HasVertexColors(0) ? 2 : 1;
+	else if ( mesh->HasVertexColors(0) )
+		nbVertexCommands++;
+	return nbVertexCommands;
+}
+
+// Primitives drawing indices, triangles of mesh, from the strip cache when they're in it
+int StripMesh(const aiMesh* mesh, const std::vector<u32>& indices, const Options& options, PrimitiveGroups& strips)
+{
+	clock_t start = clock();
+	u32 nbVertexCommands = GetNbVertexCommands(mesh, options);
+	CostModel cost(nbVertexCommands);
 
-	//BuildDualGraph(indices);
+	// Strips only depend on the faces and on how they are generated, and on the positions
+	// too when pairing triangles into quads
+	TopologyHash topology;
+	if ( indices.size() > 0 )
+		topology.Add(&indices[0], indices.size() * sizeof(u32));
+	topology.Add(options.stripper->GetName());
+	topology.Add(nbVertexCommands);
+	topology.Add(u32(options.honorWinding));
+	topology.Add(u32(options.tunnel));
+	topology.Add(options.optimizeTime);
+	topology.Add(options.quadAngle);
+	if ( options.quadAngle >= 0.0f )
+		topology.Add(mesh->mVertices, mesh->mNumVertices * sizeof(aiVector3D));
 
-	// Generate triangle strips
-#ifdef NVTRISTRIP
-	u32 nbIndices = mesh->mNumFaces * 3;
-	u16* indices = new u16[nbIndices];
-	u16* pIndices = indices;
-	for ( u32 i = 0 ; i < nbIndices / 3 ; i++ )
+	if ( options.cacheDirectory != 0 && LoadStrips(options.cacheDirectory, topology.hash, strips) )
 	{
-		ai_assert(mesh->mFaces[i].mNumIndices == 3);
-		*pIndices++ = mesh->mFaces[i].mIndices[0];
-		*pIndices++ = mesh->mFaces[i].mIndices[1];
-		*pIndices++ = mesh->mFaces[i].mIndices[2];
-	}
-	u16 nbStrips = 0;
-	PrimitiveGroup* strips = 0;
-	if ( ! GenerateStrips(indices, nbIndices, &strips, &nbStrips) )
-	{
-		fprintf(stderr, "Couldn't generate triangle strips, aborting\n");
-		delete[] indices;
-		return 4;
-	}
-#endif
-#ifdef CETS_PTERDIMAN
-	u32 nbIndices = mesh->mNumFaces * 3;
-	u32* indices = new u32[nbIndices];
-	u32* pIndices = indices;
-	for ( u32 i = 0 ; i < nbIndices / 3 ; i++ )
-	{
-		*pIndices++ = mesh->mFaces[i].mIndices[0];
-		*pIndices++ = mesh->mFaces[i].mIndices[1];
-		*pIndices++ = mesh->mFaces[i].mIndices[2];
-	}
-	STRIPERCREATE sc;
-	sc.DFaces			= indices;
-	sc.NbFaces			= mesh->mNumFaces;
-	sc.AskForWords		= true;
-	sc.ConnectAllStrips	= false;
-	sc.OneSided			= false;
-	sc.SGIAlgorithm		= false;
-
-	Striper Strip;
-	Strip.Init(sc);
-
-	STRIPERRESULT sr;
-	Strip.Compute(sr);
-	u32 nbStrips = sr.NbStrips;
-#endif
-#ifdef ACTC
-	ACTCData *tc;
-	tc = actcNew();
-	actcParami(tc, ACTC_OUT_MIN_FAN_VERTS, INT_MAX);
-	actcBeginInput(tc);
+		printf("%d primitives from the strip cache, %d bytes\n", strips.GetNbPrimitives(), cost.GetCost(strips));
+	}
+	else
+	{
+		if ( ! GenerateStrips(mesh, indices, cost, options, strips) )
+		{
+			fprintf(stderr, "Couldn't generate triangle strips, aborting\n");
+			return 4;
+		}
+		if ( options.cacheDirectory != 0 && ! SaveStrips(options.cacheDirectory, topology.hash, strips) )
+			fprintf(stderr, "Couldn't write to the strip cache in %s\n", options.cacheDirectory);
+	}
+
+	if ( options.timings )
+		printf("Strips: %d ms\n", GetMilliseconds(start));
+	return 0;
+}
+
+// A level of detail of a mesh, drawn by a display list of its own. Level 0 is the full mesh
+struct MeshLevel
+{
+	PrimitiveGroups strips;
+	u32 nbTriangles;
+	float error;		// see LodLevel
+};
+
+// Strips the full mesh and the levels of detail the options ask for
+int StripLevels(const aiMesh* mesh, const Options& options, std::vector<MeshLevel>& levels)
+{
+	std::vector<u32> indices;
 	for ( u32 i = 0 ; i < mesh->mNumFaces ; i++ )
-		actcAddTriangle(tc,
-			mesh->mFaces[i].mIndices[0], 
-			mesh->mFaces[i].mIndices[1], 
-			mesh->mFaces[i].mIndices[2]);
-	actcEndInput(tc);
-	actcBeginOutput(tc);
-	u32 prim;
-	u32 v1, v2, v3;
-	u32 nbStrips = 0;
-	std::vector<u32> stripLengths;
-	std::vector<u16> stripIndices;
-    while ( (prim = actcStartNextPrim(tc, &v1, &v2)) != ACTC_DATABASE_EMPTY )
-	{
-		nbStrips++;
-		stripIndices.push_back(v1);
-		stripIndices.push_back(v2);
-		u32 len = 2;
-		while ( actcGetNextVert(tc, &v3) != ACTC_PRIM_COMPLETE )
-		{
-			len++;
-			stripIndices.push_back(v3);
-		}
-		stripLengths.push_back(len);
-    }
-	actcEndOutput(tc);
-#endif
-	printf("%d strips generated for %d triangles\n", nbStrips, mesh->mNumFaces);
+	{
+		ai_assert(mesh->mFaces[i].mNumIndices == 3);
+		indices.push_back(mesh->mFaces[i].mIndices[0]);
+		indices.push_back(mesh->mFaces[i].mIndices[1]);
+		indices.push_back(mesh->mFaces[i].mIndices[2]);
+	}
+
+	std::vector<LodLevel> lods;
+	if ( options.lodRatios.size() > 0 )
+	{
+		clock_t start = clock();
+		BuildLodChain(indices, &mesh->mVertices[0].x, mesh->mNumVertices, options.lodRatios, lods);
+		if ( options.timings )
+			printf("LOD chain: %d ms\n", GetMilliseconds(start));
+	}
+
+	levels.resize(lods.size() + 1);
+	for ( u32 l = 0 ; l < levels.size() ; l++ )
+	{
+		const std::vector<u32>& levelIndices = l > 0 ? lods[l - 1].indices : indices;
+		levels[l].nbTriangles = levelIndices.size() / 3;
+		levels[l].error = l > 0 ? lods[l - 1].error : 0.0f;
+		if ( l > 0 )
+		{
+			printf("LOD %d: %d triangles (%.1f%%), error %f\n", l, levels[l].nbTriangles,
+				levels[0].nbTriangles > 0 ? 100.0f * levels[l].nbTriangles / levels[0].nbTriangles : 0.0f, levels[l].error);
+		}
+
+		int result = StripMesh(mesh, levelIndices, options, levels[l].strips);
+		if ( result != 0 )
+			return result;
+	}
+	return 0;
+}
+
+// Maps the bounding box of a mesh to the range of the DS vertices: a vertex is sent
+// as position * scale + translate
+struct Quantization
+{
+	Box box;
+	aiVector3D scale;
+	aiVector3D translate;
+};
+
+Quantization GetQuantization(const aiMesh* mesh)
+{
+	Quantization q;
 
 	// TODO: AABB => OBB, for higher precision
-	Box box = ComputeBoundingBox(mesh->mVertices, mesh->mNumVertices);
+	q.box = ComputeBoundingBox(mesh->mVertices, mesh->mNumVertices);
 	aiVector3D minDS(-7.99f);
 	aiVector3D maxDS(7.99f);
-	aiVector3D scale = box.max - box.min;
-	aiVector3D translate = aiVector3D(
-		box.max.x * minDS.x - box.min.x * maxDS.x,
-		box.max.y * minDS.y - box.min.y * maxDS.y,
-		box.max.z * minDS.z - box.min.z * maxDS.z);
-	translate = translate / scale;
-	scale = (maxDS - minDS) / scale;
+	aiVector3D extent = q.box.max - q.box.min;
+	q.translate = aiVector3D(
+		q.box.max.x * minDS.x - q.box.min.x * maxDS.x,
+		q.box.max.y * minDS.y - q.box.min.y * maxDS.y,
+		q.box.max.z * minDS.z - q.box.min.z * maxDS.z);
+	q.translate = q.translate / extent;
+	q.scale = (maxDS - minDS) / extent;
+	return q;
+}
+
+// Display list drawing strips with the vertices of mesh
+void BuildDisplayList(const aiMesh* mesh, const PrimitiveGroups& strips, const Options& options, std::vector<u32>& list)
+{
+	// baked lighting only needs a color per vertex
+	bool bakeLighting = options.bakeLighting && mesh->HasNormals();
+
+	u32 nbStrips = strips.GetNbPrimitives();
 
-	// Generate display list
-	std::vector<u32> list;
+	Quantization quantization = GetQuantization(mesh);
+	aiVector3D scale = quantization.scale;
+	aiVector3D translate = quantization.translate;
 
 	aiMatrix4x4 transform;
 	aiMatrix4x4::Scaling(1.0f / scale, transform);
@@ -266,79 +565,57 @@ int Convert(const char* input, const char* output)
 	u32 cmdindex = 1;
 	u32 command = 0;
 
-	u16* idx = 0;
-#ifdef CETS_PTERDIMAN
-	idx = (u16*)sr.StripRuns;
-#endif
-#ifdef ACTC
-	idx = &stripIndices[0];
-#endif
+	const u32* idx = strips.indices.size() > 0 ? &strips.indices[0] : 0;
 	for ( u32 i = 0 ; i < nbStrips ; i++ )
 	{
-#ifdef NVTRISTRIP
-		idx = strips[i].indices;
-		u32 idxLen = strips[i].numIndices;
-		if ( strips[i].type == PT_STRIP )
-		{
-			PushValue(list, command, cmdindex, 0x40, 2); // begin triangle strip
-			printf("begin strip\n");
-		}
-		else if ( strips[i].type == PT_LIST )
-		{
-			PushValue(list, command, cmdindex, 0x40, 0); // begin triangle list
-			//printf("begin list\n");
-		}
-		else // if ( strips[i]->type == PT_FAN )
-		{
-			fprintf(stderr, "Export failed, fan list generated\n");
-			return 42;
-		}
-#endif
-#ifdef CETS_PTERDIMAN
-		PushValue(list, command, cmdindex, 0x40, 2); // begin triangle strip
-		//printf("begin strip\n");
-		u32 idxLen = sr.StripLengths[i];
-#endif
-#ifdef ACTC
-		u32 idxLen = stripLengths[i];
-		PushValue(list, command, cmdindex, 0x40, 2); // begin triangle strip
-		//printf("begin strip\n");
-#endif
+		u32 idxLen = strips.lengths[i];
+		PushValue(list, command, cmdindex, 0x40, strips.types[i]); // begin primitive
 
-		for ( u32 j = idxLen ; j > 0 ; j--, idx++ )
+		u32 previous = NO_INDEX;
+		for ( u32 j = idxLen ; j > 0 ; previous = *idx, j--, idx++ )
 		{
-			if ( mesh->HasTextureCoords(0) )
+			// a repeated vertex already has its attributes set
+			if ( *idx != previous )
 			{
-				aiVector3D t = mesh->mTextureCoords[0][*idx];
-				//printf("texcoord %f %f\n", t.x, t.y);
-				t *= 1024.0f * float(1 << 4);//float(1 << 15);
-				PushValue(list, command, cmdindex, 0x22, (s32(t.x) & 0xFFFF)  | ((s32(t.y) & 0xFFFF) << 16));
-			}
+				if ( mesh->HasTextureCoords(0) )
+				{
+					aiVector3D t = mesh->mTextureCoords[0][*idx];
+					//printf("texcoord %f %f\n", t.x, t.y);
+					t *= 1024.0f * float(1 << 4);//float(1 << 15);
+					PushValue(list, command, cmdindex, 0x22, (s32(t.x) & 0xFFFF)  | ((s32(t.y) & 0xFFFF) << 16));
+				}
 
-			if ( mesh->HasNormals() )
-			{
-				// remove this ?
-				if ( mesh->HasVertexColors(0) )
+				if ( bakeLighting )
 				{
-					u32 ar = 0; u32 ag = 0; u32 ab = 0; // ambiant color, TODO: add command line parameter to set it
-					s32 r = (s32)(mesh->mColors[*idx][0].r * 31); if ( r < 0 ) r = 0; if ( r > 31 ) r = 31;
-					s32 g = (s32)(mesh->mColors[*idx][0].g * 31); if ( g < 0 ) g = 0; if ( g > 31 ) g = 31;
-					s32 b = (s32)(mesh->mColors[*idx][0].b * 31); if ( b < 0 ) b = 0; if ( b > 31 ) b = 31;
-					PushValue(list, command, cmdindex, 0x30, r | (g << 5) | (b << 10) | (ar << 16) | (ag << 21) | (ab << 26)); // material diffuse + ambiant
+					aiColor3D c = options.lightRig.Evaluate(mesh->mNormals[*idx]);
+					if ( mesh->HasVertexColors(0) )
+					{
+						const aiColor4D& vc = mesh->mColors[0][*idx];
+						c.r *= vc.r; c.g *= vc.g; c.b *= vc.b;
+					}
+					PushValue(list, command, cmdindex, 0x20, PackColor(c.r, c.g, c.b) | (1 << 15)); // color
 				}
+				else if ( mesh->HasNormals() )
+				{
+					// remove this ?
+					if ( mesh->HasVertexColors(0) )
+					{
+						u32 ar = 0; u32 ag = 0; u32 ab = 0; // ambiant color, TODO: add command line parameter to set it
+						const aiColor4D& vc = mesh->mColors[0][*idx];
+						PushValue(list, command, cmdindex, 0x30, PackColor(vc.r, vc.g, vc.b) | (ar << 16) | (ag << 21) | (ab << 26)); // material diffuse + ambiant
+					}
 
-				aiVector3D n = mesh->mNormals[*idx];
-				n.Normalize();
-				//printf("normal %f %f %f\n", n.x, n.y, n.z);
-				n *= float(1 << 9);
-				PushValue(list, command, cmdindex, 0x21, (s32(n.x) & 0x3FF | ((s32(n.y) & 0x3FF) << 10) | ((s32(n.z) & 0x3FF) << 20)));
-			}
-			else if ( mesh->HasVertexColors(0) )
-			{
-				s32 r = (s32)(mesh->mColors[*idx][0].r * 31); if ( r < 0 ) r = 0; if ( r > 31 ) r = 31;
-				s32 g = (s32)(mesh->mColors[*idx][0].g * 31); if ( g < 0 ) g = 0; if ( g > 31 ) g = 31;
-				s32 b = (s32)(mesh->mColors[*idx][0].b * 31); if ( b < 0 ) b = 0; if ( b > 31 ) b = 31;
-				PushValue(list, command, cmdindex, 0x20, r | (g << 5) | (b << 10) | (1 << 15)); // color
+					aiVector3D n = mesh->mNormals[*idx];
+					n.Normalize();
+					//printf("normal %f %f %f\n", n.x, n.y, n.z);
+					n *= float(1 << 9);
+					PushValue(list, command, cmdindex, 0x21, (s32(n.x) & 0x3FF | ((s32(n.y) & 0x3FF) << 10) | ((s32(n.z) & 0x3FF) << 20)));
+				}
+				else if ( mesh->HasVertexColors(0) )
+				{
+					const aiColor4D& vc = mesh->mColors[0][*idx];
+					PushValue(list, command, cmdindex, 0x20, PackColor(vc.r, vc.g, vc.b) | (1 << 15)); // color
+				}
 			}
 
 			aiVector3D p = mesh->mVertices[*idx];
@@ -352,30 +629,760 @@ int Convert(const char* input, const char* output)
 			PushValue(list, command, cmdindex, 0x24, ((px) & 0x3FF) | (((py) & 0x3FF) << 10) | (((pz) & 0x3FF) << 20));
 		}
 	}
+}
+
+// Replaces list by its chunks when options split the display lists. Returns 0, or 6 if a command
+// packet doesn't fit in a chunk
+int SplitDisplayList(const Options& options, std::vector<u32>& list)
+{
+	if ( options.chunkSize == 0 )
+		return 0;
+
+	std::vector<u32> chunked;
+	if ( ! ChunkDisplayList(list, options.chunkSize, chunked) )
+	{
+		fprintf(stderr, "A command packet doesn't fit in chunks of %d bytes\n", options.chunkSize);
+		return 6;
+	}
+	list.swap(chunked);
+	return 0;
+}
 
-	// Output file
+// Replaces list by the smallest of its compressions in the formats of options, unless none is
+// smaller than list itself. Returns the format of list then
+CompressionType CompressDisplayList(const Options& options, std::vector<u32>& list)
+{
+	if ( options.compressions.empty() || list.empty() )
+		return COMPRESSION_NONE;
+
+	std::vector<u8> compressed;
+	CompressionType type = CompressSmallest(&options.compressions[0], options.compressions.size(), (const u8*)&list[0], list.size() * sizeof(list[0]), compressed);
+	if ( type == COMPRESSION_NONE || compressed.size() >= list.size() * sizeof(list[0]) )
+		return COMPRESSION_NONE;
+
+	// compressed is padded to whole words
+	list.resize(compressed.size() / sizeof(list[0]));
+	memcpy(&list[0], &compressed[0], compressed.size());
+	return type;
+}
+
+int WriteDisplayList(const char* output, const std::vector<u32>& list)
+{
 	FILE* f = fopen(output, "wb");
+	if ( f == 0 )
+	{
+		fprintf(stderr, "Could not write %s\n", output);
+		return 5;
+	}
 	fwrite(&list[0], sizeof(list[0]), list.size(), f);
 	fclose(f);
+	return 0;
+}
+
+// Where level goes when writing output: output itself for the full mesh, and output with
+// _lod<level> before its extension for the others
+std::string GetLevelPath(const char* output, u32 level)
+{
+	std::string path = output;
+	if ( level == 0 )
+		return path;
 
-#ifdef NVTRISTRIP
-	delete[] strips;
-	delete[] indices;
-#endif
-#ifdef CETS_PTERDIMAN
-	delete[] indices;
-#endif
+	char suffix[16];
+	sprintf(suffix, "_lod%d", level);
+	size_t dot = path.find_last_of('.');
+	size_t separator = path.find_last_of("/\\");
+	if ( dot == std::string::npos || (separator != std::string::npos && dot < separator) )
+		return path + suffix;
+	return path.insert(dot, suffix);
+}
+
+// Converts input, stats being those of the full mesh
+int Convert(Assimp::Importer& importer, const char* input, const char* output, const Options& options, ConvertStats& stats)
+{
+	const aiMesh* mesh;
+	int result = ImportMesh(importer, input, options, mesh);
+	if ( result != 0 )
+		return result;
+
+	std::vector<MeshLevel> levels;
+	result = StripLevels(mesh, options, levels);
+	if ( result != 0 )
+		return result;
+
+	clock_t start = clock();
+	for ( u32 l = 0 ; l < levels.size() ; l++ )
+	{
+		std::vector<u32> list;
+		BuildDisplayList(mesh, levels[l].strips, options, list);
+		result = SplitDisplayList(options, list);
+		if ( result != 0 )
+			return result;
+		CompressDisplayList(options, list);
+		result = WriteDisplayList(GetLevelPath(output, l).c_str(), list);
+		if ( result != 0 )
+			return result;
 
+		if ( l == 0 )
+		{
+			stats.nbTriangles = levels[l].nbTriangles;
+			stats.nbPrimitives = levels[l].strips.GetNbPrimitives();
+			stats.size = list.size() * sizeof(list[0]);
+		}
+	}
+	if ( options.timings )
+		printf("Display list: %d ms\n", GetMilliseconds(start));
+	return 0;
+}
+
+// Reads the options and the files of a command line, without the program name
+void ParseArguments(int argc, char** argv, Options& options, const char*& stripperName, const char** files, u32& nbFiles, bool& server)
+{
+	for ( int i = 0 ; i < argc ; i++ )
+	{
+		if ( strcmp(argv[i], "-stripper") == 0 && i + 1 < argc )
+		{
+			stripperName = argv[++i];
+		}
+		else if ( strcmp(argv[i], "-quadangle") == 0 && i + 1 < argc )
+		{
+			options.quadAngle = (float)atof(argv[++i]);
+		}
+		else if ( strcmp(argv[i], "-winding") == 0 )
+		{
+			options.honorWinding = true;
+		}
+		else if ( strcmp(argv[i], "-bake") == 0 )
+		{
+			options.bakeLighting = true;
+		}
+		else if ( strcmp(argv[i], "-light") == 0 && i + 6 < argc )
+		{
+			float v[6];
+			for ( u32 j = 0 ; j < 6 ; j++ )
+				v[j] = (float)atof(argv[++i]);
+			options.lightRig.AddLight(aiVector3D(v[0], v[1], v[2]), aiColor3D(v[3], v[4], v[5]));
+		}
+		else if ( strcmp(argv[i], "-ambient") == 0 && i + 3 < argc )
+		{
+			float r = (float)atof(argv[++i]);
+			float g = (float)atof(argv[++i]);
+			float b = (float)atof(argv[++i]);
+			options.lightRig.ambient = aiColor3D(r, g, b);
+		}
+		else if ( strcmp(argv[i], "-cache") == 0 && i + 1 < argc )
+		{
+			options.cacheDirectory = argv[++i];
+		}
+		else if ( strcmp(argv[i], "-import") == 0 && i + 1 < argc )
+		{
+			const char* name = argv[++i];
+			u32 j = 0;
+			while ( j < nbImportProfiles && strcmp(name, importProfiles[j].name) != 0 )
+				j++;
+			if ( j < nbImportProfiles )
+				options.importFlags = importProfiles[j].flags;
+			else
+			{
+				// the profile in effect may come from the server's command line
+				u32 k = 0;
+				while ( k < nbImportProfiles && importProfiles[k].flags != options.importFlags )
+					k++;
+				fprintf(stderr, "Unknown import profile %s, keeping %s\n", name, k < nbImportProfiles ? importProfiles[k].name : "the current one");
+			}
+		}
+		else if ( strcmp(argv[i], "-compress") == 0 && i + 1 < argc )
+		{
+			const char* name = argv[++i];
+			u32 j = 0;
+			while ( j < nbCompressionProfiles && strcmp(name, compressionProfiles[j].name) != 0 )
+				j++;
+			if ( j < nbCompressionProfiles )
+				options.compressions.assign(compressionProfiles[j].types, compressionProfiles[j].types + compressionProfiles[j].nbTypes);
+			else
+				fprintf(stderr, "Unknown compression %s, keeping the display lists as they are\n", name);
+		}
+		else if ( strcmp(argv[i], "-chunk") == 0 && i + 1 < argc )
+		{
+			// whole cache lines, enough for a matrix and the packet after it
+			s32 size = atoi(argv[++i]);
+			options.chunkSize = size > 0 ? std::max(size & ~(CHUNK_ALIGNMENT - 1), 2 * CHUNK_ALIGNMENT) : 0;
+		}
+		else if ( strcmp(argv[i], "-timings") == 0 )
+		{
+			options.timings = true;
+		}
+		else if ( strcmp(argv[i], "-server") == 0 )
+		{
+			server = true;
+		}
+		else if ( strcmp(argv[i], "-batch") == 0 && i + 1 < argc )
+		{
+			options.batchList = argv[++i];
+		}
+		else if ( strcmp(argv[i], "-stages") == 0 && i + NB_STAGES < argc )
+		{
+			for ( u32 j = 0 ; j < NB_STAGES ; j++ )
+			{
+				s32 workers = atoi(argv[++i]);
+				options.stageWorkers[j] = workers > 0 ? workers : 1;
+			}
+		}
+		else if ( strcmp(argv[i], "-lod") == 0 && i + 1 < argc )
+		{
+			// ratios separated by commas, from the most detailed level
+			options.lodRatios.clear();
+			const char* ratios = argv[++i];
+			while ( *ratios != 0 )
+			{
+				char* end;
+				float ratio = (float)strtod(ratios, &end);
+				if ( end == ratios )
+					break;
+				if ( ratio > 0.0f && ratio < 1.0f )
+					options.lodRatios.push_back(ratio);
+				ratios = *end == ',' ? end + 1 : end;
+			}
+			std::sort(options.lodRatios.begin(), options.lodRatios.end(), std::greater<float>());
+		}
+		else if ( strcmp(argv[i], "-pack") == 0 && i + 1 < argc )
+		{
+			options.packFile = argv[++i];
+		}
+		else if ( strcmp(argv[i], "-queue") == 0 && i + 1 < argc )
+		{
+			s32 size = atoi(argv[++i]);
+			options.queueSize = size > 0 ? size : 1;
+		}
+		else if ( strcmp(argv[i], "-tunnel") == 0 )
+		{
+			options.tunnel = true;
+		}
+		else if ( strcmp(argv[i], "-optimize") == 0 && i + 1 < argc )
+		{
+			options.optimizeTime = (float)atof(argv[++i]);
+		}
+		else if ( nbFiles < 2 )
+		{
+			files[nbFiles++] = argv[i];
+		}
+	}
+}
+
+void PrintUsage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-stripper <name>] [-quadangle <degrees>] [-winding] [-bake] [-light <x> <y> <z> <r> <g> <b>]... [-ambient <r> <g> <b>] [-tunnel] [-optimize <seconds>] [-cache <directory>] [-import <profile>] [-lod <ratios>] [-compress <format>] [-chunk <bytes>] [-timings] <input> <output>\n", name);
+	fprintf(stderr, "       %s -server [options]\n", name);
+	fprintf(stderr, "       %s -batch <list> [-stages <read> <import> <strip> <emit>] [-queue <files>] [-pack <file>] [options]\n", name);
+	fprintf(stderr, "-quadangle: max angle between the triangles of a quad, negative for no quads (default 1)\n");
+	fprintf(stderr, "-winding: keep the winding of every triangle, so that back faces can be culled\n");
+	fprintf(stderr, "-bake: light the vertices with the light rig, the display list has colors instead of normals and needs lighting off\n");
+	fprintf(stderr, "-light: add a directional light going along x y z to the rig (default one white light going along 0 -1 -1)\n");
+	fprintf(stderr, "-ambient: ambient color of the rig (default 0.25 0.25 0.25)\n");
+	fprintf(stderr, "-tunnel: merge strips along tunnels of the dual graph\n");
+	fprintf(stderr, "-optimize: time spent improving the strips, tunneling included (default 0)\n");
+	fprintf(stderr, "-cache: reuse the strips of meshes with the same faces, stored in directory\n");
+	fprintf(stderr, "-import: Assimp post-processing profile, one of");
+	for ( u32 i = 0 ; i < nbImportProfiles ; i++ )
+		fprintf(stderr, " %s%s", importProfiles[i].name, i == 0 ? " (default)" : "");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-lod: also convert levels of detail with these ratios of the triangles, separated by commas (0.5,0.25),\n");
+	fprintf(stderr, "      written to <output>_lod<level> or to the pack after the full mesh\n");
+	fprintf(stderr, "-compress: compress the display lists for the DS BIOS decompressors, one of");
+	for ( u32 i = 0 ; i < nbCompressionProfiles ; i++ )
+		fprintf(stderr, " %s%s", compressionProfiles[i].name, i == 0 ? " (default)" : "");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "          huffman keeps the smaller of 4 and 8 bits, best the smallest of all, and a list is kept as it is\n");
+	fprintf(stderr, "          when it's smaller that way\n");
+	fprintf(stderr, "-chunk: split the display lists into chunks of whole command packets, aligned on cache lines and\n");
+	fprintf(stderr, "        of at most this many bytes (64 at least), after an index of the chunks\n");
+	fprintf(stderr, "-timings: print the time taken by every import step and conversion stage\n");
+	fprintf(stderr, "-server: convert the jobs read from stdin, one per line with the options and files of a command line,\n");
+	fprintf(stderr, "         answering \"ok <output> <triangles> <primitives> <bytes> <milliseconds>\" or \"error <code> <input>\",\n");
+	fprintf(stderr, "         with the progress messages going to stderr\n");
+	fprintf(stderr, "-batch: convert the files of list, one \"<input> <output>\" per line, reading, importing, stripping and\n");
+	fprintf(stderr, "        emitting different files at the same time\n");
+	fprintf(stderr, "-stages: threads of each batch stage (default 2 2 <processors> 1)\n");
+	fprintf(stderr, "-queue: files waiting between two batch stages, at most (default 4)\n");
+	fprintf(stderr, "-pack: put the meshes of the batch into one pack file, named by the second column of the list\n");
+	fprintf(stderr, "       or else by their input file\n");
+	fprintf(stderr, "Strippers:");
+	for ( u32 i = 0 ; i < nbStrippers ; i++ )
+		fprintf(stderr, " %s%s", stripperNames[i], i == 0 ? " (default)" : "");
+	fprintf(stderr, "\n");
+}
+
+// Reads a line of f into line, however long it is. Returns false at the end of f
+bool ReadLine(FILE* f, std::string& line)
+{
+	line.clear();
+	char buffer[4096];
+	while ( fgets(buffer, sizeof(buffer), f) != 0 )
+	{
+		line += buffer;
+		if ( ! line.empty() && line[line.size() - 1] == '\n' )
+			return true;
+	}
+	return ! line.empty();
+}
+
+// Splits line at spaces, except between double quotes
+void Tokenize(const char* line, std::vector<std::string>& tokens)
+{
+	tokens.clear();
+	while ( *line != 0 )
+	{
+		while ( *line == ' ' || *line == '\t' || *line == '\r' || *line == '\n' )
+			line++;
+		if ( *line == 0 )
+			break;
+
+		std::string token;
+		bool quoted = false;
+		for ( ; *line != 0 && (quoted || (*line != ' ' && *line != '\t' && *line != '\r' && *line != '\n')) ; line++ )
+		{
+			if ( *line == '"' )
+				quoted = ! quoted;
+			else
+				token += *line;
+		}
+		tokens.push_back(token);
+	}
+}
+
+// Converts the jobs read from stdin until "quit" or the end of the input, keeping the importer
+// and the strippers from one job to the next. A job is a line with the options and files of a
+// command line, its options going on top of the ones the server started with. Every job is
+// answered with one line on stdout, and nothing else goes there: the progress messages of the
+// conversion are sent to stderr
+int Serve(const Options& serverOptions, const char* serverStripper)
+{
+	// the replies keep the real stdout, which then becomes stderr for everything else
+	fflush(stdout);
+	int replyFile = _dup(_fileno(stdout));
+	FILE* replies = replyFile >= 0 ? _fdopen(replyFile, "w") : 0;
+	if ( replies == 0 || _dup2(_fileno(stderr), _fileno(stdout)) < 0 )
+	{
+		fprintf(stderr, "Could not keep stdout for the replies\n");
+		return 1;
+	}
+
+	Assimp::Importer importer;
+	ConfigureImporter(importer);
+	std::map<std::string, Stripper*> strippers;
+
+	std::string line;
+	std::vector<std::string> tokens;
+	std::vector<char*> args;
+	while ( ReadLine(stdin, line) )
+	{
+		Tokenize(line.c_str(), tokens);
+		if ( tokens.empty() )
+			continue;
+		if ( tokens[0] == "quit" )
+			break;
+
+		args.clear();
+		for ( u32 i = 0 ; i < tokens.size() ; i++ )
+			args.push_back(&tokens[i][0]);
+
+		Options options = serverOptions;
+		const char* stripperName = serverStripper;
+		const char* files[2] = { 0, 0 };
+		u32 nbFiles = 0;
+		bool server = false;
+		ParseArguments(args.size(), &args[0], options, stripperName, files, nbFiles, server);
+
+		Stripper*& stripper = strippers[stripperName];
+		if ( stripper == 0 )
+			stripper = CreateStripper(stripperName);
+		if ( nbFiles < 2 || stripper == 0 )
+		{
+			fprintf(replies, "error 42 %s\n", nbFiles > 0 ? files[0] : "");
+			fflush(replies);
+			continue;
+		}
+
+		options.stripper = stripper;
+		stripper->SetHonorWinding(options.honorWinding);
+		if ( options.lightRig.lights.empty() )
+			options.lightRig.AddLight(aiVector3D(0.0f, -1.0f, -1.0f), aiColor3D(1.0f, 1.0f, 1.0f));
+
+		clock_t start = clock();
+		ConvertStats stats;
+		int result = Convert(importer, files[0], files[1], options, stats);
+		u32 milliseconds = GetMilliseconds(start);
+		fflush(stdout);
+		if ( result == 0 )
+			fprintf(replies, "ok %s %d %d %d %d\n", files[1], stats.nbTriangles, stats.nbPrimitives, stats.size, milliseconds);
+		else
+			fprintf(replies, "error %d %s\n", result, files[0]);
+		fflush(replies);
+	}
+
+	std::map<std::string, Stripper*>::iterator it;
+	for ( it = strippers.begin() ; it != strippers.end() ; ++it )
+		delete it->second;
+	fclose(replies);
 	return 0;
 }
 
+// A file going through the batch stages
+struct BatchJob
+{
+	std::string input;
+	std::string output;				// or name of the pack entry
+	std::vector<char> data;			// contents of input, until imported
+	Assimp::Importer* importer;		// owns the mesh, until emitted
+	const aiMesh* mesh;
+	std::vector<MeshLevel> levels;
+	int result;						// the stages after a failed one pass the job on
+	std::vector<PackEntry> entries;	// of each level, with their display lists, kept for the pack
+	std::vector<std::vector<u32> > lists;
+};
+
+static const char* const stageNames[NB_STAGES] = { "read", "import", "strip", "emit" };
+
+// Name of the mesh in path, without its directory and extension
+std::string GetBaseName(const std::string& path)
+{
+	size_t start = path.find_last_of("/\\");
+	start = start != std::string::npos ? start + 1 : 0;
+	size_t end = path.find_last_of('.');
+	return path.substr(start, end != std::string::npos && end > start ? end - start : std::string::npos);
+}
+
+// Describes the display list of a level of mesh in a pack, but for where it goes
+void FillPackEntry(const aiMesh* mesh, const char* name, u32 lod, const MeshLevel& level, CompressionType compression, PackEntry& entry)
+{
+	memset(&entry, 0, sizeof(entry));
+	if ( lod == 0 && strlen(name) >= PACK_NAME_LENGTH )
+		fprintf(stderr, "%s is too long a name for a pack, cut to %d characters\n", name, PACK_NAME_LENGTH - 1);
+	strncpy(entry.name, name, PACK_NAME_LENGTH - 1);
+	entry.compression = compression;
+	entry.nbTriangles = level.nbTriangles;
+	entry.nbPrimitives = level.strips.GetNbPrimitives();
+	entry.lod = lod;
+	entry.error = level.error;
+
+	Quantization q = GetQuantization(mesh);
+	for ( u32 i = 0 ; i < 3 ; i++ )
+	{
+		entry.boxMin[i] = q.box.min[i];
+		entry.boxMax[i] = q.box.max[i];
+		entry.scale[i] = q.scale[i];
+		entry.translate[i] = q.translate[i];
+	}
+}
+
+// Stages running on threads of their own, with bounded queues between them: the files are read
+// while others are imported, stripped or emitted, and no more than a few wait in memory
+struct BatchPipeline
+{
+	const Options* options;
+	WorkQueue* queues[NB_STAGES];			// jobs waiting for each stage
+	std::vector<Options> stripOptions;		// one stripper per strip thread
+	std::vector<u32> busy[NB_STAGES];		// time spent working by each thread, in ms
+};
+
+// Threads of one stage
+struct BatchStageThreads
+{
+	BatchPipeline* pipeline;
+	BatchStage stage;
+};
+
+void RunBatchStage(BatchPipeline& pipeline, BatchStage stage, u32 thread, BatchJob& job)
+{
+	const Options& options = *pipeline.options;
+	switch ( stage )
+	{
+	case STAGE_READ:
+		if ( ! ReadWholeFile(job.input.c_str(), job.data) )
+		{
+			fprintf(stderr, "Could not read %s\n", job.input.c_str());
+			job.result = 1;
+		}
+		break;
+
+	case STAGE_IMPORT:
+		{
+			// Assimp parses the file from memory, the handler being given back before it's deleted
+			job.importer = new Assimp::Importer;
+			ConfigureImporter(*job.importer);
+			PrefetchIOSystem* io = new PrefetchIOSystem(job.input.c_str(), job.data);
+			job.importer->SetIOHandler(io);
+			job.result = ImportMesh(*job.importer, job.input.c_str(), options, job.mesh);
+			job.importer->SetIOHandler(0);
+			delete io;
+			std::vector<char>().swap(job.data);
+		}
+		break;
+
+	case STAGE_STRIP:
+		job.result = StripLevels(job.mesh, pipeline.stripOptions[thread], job.levels);
+		break;
+
+	case STAGE_EMIT:
+		for ( u32 l = 0 ; l < job.levels.size() && job.result == 0 ; l++ )
+		{
+			const MeshLevel& level = job.levels[l];
+			std::vector<u32> list;
+			BuildDisplayList(job.mesh, level.strips, options, list);
+			job.result = SplitDisplayList(options, list);
+			if ( job.result != 0 )
+				break;
+			CompressionType compression = CompressDisplayList(options, list);
+			u32 size = list.size() * sizeof(list[0]);
+			if ( options.packFile != 0 )
+			{
+				job.entries.push_back(PackEntry());
+				FillPackEntry(job.mesh, job.output.c_str(), l, level, compression, job.entries.back());
+				job.entries.back().chunkSize = options.chunkSize;
+				job.lists.push_back(std::vector<u32>());
+				job.lists.back().swap(list);
+			}
+			else
+			{
+				job.result = WriteDisplayList(GetLevelPath(job.output.c_str(), l).c_str(), list);
+			}
+			if ( job.result == 0 )
+				printf("%s: LOD %d, %d triangles, %d primitives, %d bytes\n", job.output.c_str(), l, level.nbTriangles, level.strips.GetNbPrimitives(), size);
+		}
+		job.levels.clear();
+		break;
+
+	default:
+		break;
+	}
+}
+
+void BatchStageMain(u32 index, u32 /*worker*/, void* userData)
+{
+	BatchStageThreads& threads = *(BatchStageThreads*)userData;
+	BatchPipeline& pipeline = *threads.pipeline;
+	BatchStage stage = threads.stage;
+
+	while ( BatchJob* job = (BatchJob*)pipeline.queues[stage]->Pop() )
+	{
+		clock_t start = clock();
+		if ( job->result == 0 )
+			RunBatchStage(pipeline, stage, index, *job);
+		pipeline.busy[stage][index] += GetMilliseconds(start);
+
+		// the scene goes with the last stage, or as soon as the job fails
+		if ( job->importer != 0 && (stage == STAGE_EMIT || job->result != 0) )
+		{
+			delete job->importer;
+			job->importer = 0;
+			job->mesh = 0;
+		}
+		if ( stage + 1 < NB_STAGES )
+			pipeline.queues[stage + 1]->Push(job);
+	}
+
+	if ( stage + 1 < NB_STAGES )
+		pipeline.queues[stage + 1]->Done();
+}
+
+// Converts the files listed in options.batchList, returns 0 if all of them were converted or
+// else the code of the first one which failed
+int ConvertBatch(const Options& options, const char* stripperName)
+{
+	FILE* f = fopen(options.batchList, "r");
+	if ( f == 0 )
+	{
+		fprintf(stderr, "Could not read %s\n", options.batchList);
+		return 1;
+	}
+
+	std::vector<BatchJob> jobs;
+	std::string line;
+	std::vector<std::string> tokens;
+	for ( u32 lineNumber = 1 ; ReadLine(f, line) ; lineNumber++ )
+	{
+		Tokenize(line.c_str(), tokens);
+		if ( tokens.empty() )
+			continue;
+		if ( tokens.size() > 2 || (tokens.size() < 2 && options.packFile == 0) )
+		{
+			fprintf(stderr, "%s(%d): expecting \"<input> <output>\", skipping\n", options.batchList, lineNumber);
+			continue;
+		}
+
+		BatchJob job;
+		job.input = tokens[0];
+		job.output = tokens.size() > 1 ? tokens[1] : GetBaseName(tokens[0]);
+		job.importer = 0;
+		job.mesh = 0;
+		job.result = 0;
+		jobs.push_back(job);
+	}
+	fclose(f);
+
+	BatchPipeline pipeline;
+	pipeline.options = &options;
+	for ( u32 s = 0 ; s < NB_STAGES ; s++ )
+	{
+		// a stage is fed by the threads of the one before, the first one by this thread
+		pipeline.queues[s] = new WorkQueue(options.queueSize, s > 0 ? options.stageWorkers[s - 1] : 1);
+		pipeline.busy[s].assign(options.stageWorkers[s], 0);
+	}
+	for ( u32 i = 0 ; i < options.stageWorkers[STAGE_STRIP] ; i++ )
+	{
+		Options stripOptions = options;
+		stripOptions.stripper = CreateStripper(stripperName);
+		stripOptions.stripper->SetHonorWinding(options.honorWinding);
+		// the strip threads share the processors rather than each using them all
+		stripOptions.stripper->SetNbThreads(std::max(1u, GetNbProcessors() / options.stageWorkers[STAGE_STRIP]));
+		pipeline.stripOptions.push_back(stripOptions);
+	}
+
+	clock_t start = clock();
+	BatchStageThreads stageThreads[NB_STAGES];
+	ThreadGroup threads;
+	s32 failedStage = -1;
+	// from the last stage to the first, so that a stage which can't start has no thread before
+	// it waiting to push jobs
+	for ( s32 s = NB_STAGES - 1 ; s >= 0 && failedStage < 0 ; s-- )
+	{
+		stageThreads[s].pipeline = &pipeline;
+		stageThreads[s].stage = BatchStage(s);
+		u32 nbStarted = threads.Start(options.stageWorkers[s], BatchStageMain, &stageThreads[s]);
+		if ( nbStarted == options.stageWorkers[s] )
+			continue;
+
+		// the threads which didn't start are done for the stage after, and those which did
+		// get no job, as the stages before aren't started
+		failedStage = s;
+		for ( u32 i = nbStarted ; i < options.stageWorkers[s] && s + 1 < NB_STAGES ; i++ )
+			pipeline.queues[s + 1]->Done();
+		u32 nbProducers = s > 0 ? options.stageWorkers[s - 1] : 1;
+		for ( u32 i = 0 ; i < nbProducers ; i++ )
+			pipeline.queues[s]->Done();
+	}
+
+	if ( failedStage < 0 )
+	{
+		for ( u32 i = 0 ; i < jobs.size() ; i++ )
+			pipeline.queues[STAGE_READ]->Push(&jobs[i]);
+		pipeline.queues[STAGE_READ]->Done();
+	}
+	threads.Join();
+
+	int result = 0;
+	if ( failedStage >= 0 )
+	{
+		fprintf(stderr, "Could not start the %s threads\n", stageNames[failedStage]);
+		for ( u32 i = 0 ; i < jobs.size() ; i++ )
+			jobs[i].result = 1;
+	}
+	u32 nbConverted = 0;
+	for ( u32 i = 0 ; i < jobs.size() ; i++ )
+	{
+		if ( jobs[i].result == 0 )
+			nbConverted++;
+		else if ( result == 0 )
+			result = jobs[i].result;
+	}
+	printf("%d of %d files converted in %d ms\n", nbConverted, jobs.size(), GetMilliseconds(start));
+
+	// in the order of the list, whatever order the files were converted in
+	if ( options.packFile != 0 && failedStage < 0 )
+	{
+		std::vector<PackEntry> entries;
+		std::vector<std::vector<u32> > lists;
+		for ( u32 i = 0 ; i < jobs.size() ; i++ )
+		{
+			if ( jobs[i].result != 0 )
+				continue;
+			for ( u32 l = 0 ; l < jobs[i].entries.size() ; l++ )
+			{
+				entries.push_back(jobs[i].entries[l]);
+				lists.push_back(std::vector<u32>());
+				lists.back().swap(jobs[i].lists[l]);
+			}
+		}
+		if ( ! WritePack(options.packFile, entries, lists) )
+		{
+			fprintf(stderr, "Could not write %s\n", options.packFile);
+			result = 5;
+		}
+	}
+
+	// a stage busier than the others for its number of threads is the one to give more
+	if ( options.timings )
+	{
+		for ( u32 s = 0 ; s < NB_STAGES ; s++ )
+		{
+			u32 busy = 0;
+			for ( u32 i = 0 ; i < pipeline.busy[s].size() ; i++ )
+				busy += pipeline.busy[s][i];
+			printf("  %-8s %d threads, %d ms busy\n", stageNames[s], options.stageWorkers[s], busy);
+		}
+	}
+
+	for ( u32 i = 0 ; i < pipeline.stripOptions.size() ; i++ )
+		delete pipeline.stripOptions[i].stripper;
+	for ( u32 s = 0 ; s < NB_STAGES ; s++ )
+		delete pipeline.queues[s];
+	return result;
+}
+
 int main(int argc, char** argv)
 {
-	if ( argc < 3 )
+	const char* stripperName = stripperNames[0];
+	Options options;
+	options.quadAngle = 1.0f;
+	options.optimizeTime = 0.0f;
+	options.tunnel = false;
+	options.honorWinding = false;
+	options.bakeLighting = false;
+	options.cacheDirectory = 0;
+	options.importFlags = importProfiles[0].flags;
+	options.timings = false;
+	options.batchList = 0;
+	options.stageWorkers[STAGE_READ] = 2;
+	options.stageWorkers[STAGE_IMPORT] = 2;
+	options.stageWorkers[STAGE_STRIP] = GetNbProcessors();
+	options.stageWorkers[STAGE_EMIT] = 1;
+	options.queueSize = 4;
+	options.packFile = 0;
+	options.chunkSize = 0;
+	options.lightRig.ambient = aiColor3D(0.25f, 0.25f, 0.25f);
+	const char* files[2] = { 0, 0 };
+	u32 nbFiles = 0;
+	bool server = false;
+	ParseArguments(argc - 1, argv + 1, options, stripperName, files, nbFiles, server);
+
+	if ( server )
+		return Serve(options, stripperName);
+
+	if ( options.lightRig.lights.empty() )
+		options.lightRig.AddLight(aiVector3D(0.0f, -1.0f, -1.0f), aiColor3D(1.0f, 1.0f, 1.0f));
+
+	Stripper* stripper = CreateStripper(stripperName);
+	if ( options.batchList != 0 && stripper != 0 )
 	{
-		fprintf(stderr, "Usage: %s <input> <output>\n", argv[0]);
+		delete stripper;
+		return ConvertBatch(options, stripperName);
+	}
+	if ( nbFiles < 2 || stripper == 0 )
+	{
+		PrintUsage(argv[0]);
+		delete stripper;
 		return 42;
 	}
 
-	return Convert(argv[1], argv[2]);
-}
\ No newline at end of file
+	if ( options.packFile != 0 )
+		fprintf(stderr, "-pack is only for -batch, writing %s\n", files[1]);
+
+	options.stripper = stripper;
+	stripper->SetHonorWinding(options.honorWinding);
+
+	Assimp::Importer importer;
+	ConfigureImporter(importer);
+	ConvertStats stats;
+	int result = Convert(importer, files[0], files[1], options, stats);
+	delete stripper;
+	return result;
+}
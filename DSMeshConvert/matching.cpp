@@ -0,0 +1,448 @@
+#include "matching.h"
+#include "stripping.h"
+#include "thread.h"
+#include <algorithm>
+
+static const u32 NO_NODE = 0xFFFFFFFF;
+
+// Edmonds' blossom algorithm, growing alternating trees from the unmatched nodes. A blossom
+// (odd cycle) is contracted by joining its nodes to its base in a union-find, and the odd
+// nodes it holds become even. Only the nodes of the current tree are reset after a search
+struct Matching
+{
+	enum Color
+	{
+		NONE,
+		EVEN,
+		ODD,
+	};
+
+	const std::vector<std::set<u32> >& graph;
+	std::vector<u32>& mates;
+	std::vector<u32> parents;		// previous node of the odd nodes in the tree
+	std::vector<u32> bases;			// union-find of the contracted blossoms
+	std::vector<u32> colors;
+	std::vector<u32> visits;		// last search for a common base which saw a node
+	std::vector<u32> tree;			// nodes of the current tree
+	std::vector<u32> queue;			// even nodes to grow the tree from
+	u32 visit;
+
+	Matching(const std::vector<std::set<u32> >& dualGraph, std::vector<u32>& nodeMates)
+	: graph(dualGraph)
+	, mates(nodeMates)
+	, parents(graph.size(), NO_NODE)
+	, bases(graph.size())
+	, colors(graph.size(), NONE)
+	, visits(graph.size(), 0)
+	, visit(0)
+	{
+		mates.assign(graph.size(), NO_NODE);
+		for ( u32 i = 0 ; i < graph.size() ; i++ )
+			bases[i] = i;
+	}
+
+	u32 FindBase(u32 node)
+	{
+		u32 base = node;
+		while ( bases[base] != base )
+			base = bases[base];
+		while ( bases[node] != base )
+		{
+			u32 next = bases[node];
+			bases[node] = base;
+			node = next;
+		}
+		return base;
+	}
+
+	// Base of the blossom closed by the edge a-b, between two even nodes of the tree
+	u32 FindCommonBase(u32 a, u32 b)
+	{
+		visit++;
+		a = FindBase(a);
+		b = FindBase(b);
+		for ( ;; )
+		{
+			if ( a != NO_NODE )
+			{
+				if ( visits[a] == visit )
+					return a;
+				visits[a] = visit;
+				a = mates[a] != NO_NODE ? FindBase(parents[mates[a]]) : NO_NODE;
+			}
+			std::swap(a, b);
+		}
+	}
+
+	// Contracts the side of the blossom going from node up to base, child being the node it was reached from
+	void Contract(u32 node, u32 child, u32 base)
+	{
+		while ( FindBase(node) != base )
+		{
+			parents[node] = child;
+			child = mates[node];
+			if ( colors[child] == ODD )
+			{
+				colors[child] = EVEN;
+				queue.push_back(child);
+			}
+			if ( FindBase(node) == node )
+				bases[node] = base;
+			if ( FindBase(child) == child )
+				bases[child] = base;
+			node = parents[child];
+		}
+	}
+
+	void AddToTree(u32 node, u32 color)
+	{
+		colors[node] = color;
+		tree.push_back(node);
+		if ( color == EVEN )
+			queue.push_back(node);
+	}
+
+	// Swaps the matched and unmatched edges of the tree path from the root to node
+	void Augment(u32 node)
+	{
+		while ( node != NO_NODE )
+		{
+			u32 parent = parents[node];
+			u32 next = mates[parent];
+			mates[node] = parent;
+			mates[parent] = node;
+			node = next;
+		}
+	}
+
+	// Searches an augmenting path from root, an unmatched node, and augments the matching along it
+	bool Grow(u32 root)
+	{
+		tree.clear();
+		queue.clear();
+		AddToTree(root, EVEN);
+
+		bool augmented = false;
+		for ( u32 q = 0 ; q < queue.size() && ! augmented ; q++ )
+		{
+			u32 x = queue[q];
+			std::set<u32>::const_iterator it;
+			for ( it = graph[x].begin() ; it != graph[x].end() ; ++it )
+			{
+				u32 y = *it;
+				if ( colors[y] == ODD || FindBase(x) == FindBase(y) )
+					continue;
+
+				if ( colors[y] == EVEN )
+				{
+					u32 base = FindCommonBase(x, y);
+					Contract(x, y, base);
+					Contract(y, x, base);
+					continue;
+				}
+
+				parents[y] = x;
+				AddToTree(y, ODD);
+				if ( mates[y] == NO_NODE )
+				{
+					Augment(y);
+					augmented = true;
+					break;
+				}
+				AddToTree(mates[y], EVEN);
+			}
+		}
+
+		for ( u32 i = 0 ; i < tree.size() ; i++ )
+		{
+			parents[tree[i]] = NO_NODE;
+			bases[tree[i]] = tree[i];
+			colors[tree[i]] = NONE;
+		}
+		return augmented;
+	}
+
+	u32 Build()
+	{
+		// start from a greedy matching, nodes with fewer neighbours first
+		std::vector<std::pair<u32, u32> > order;
+		for ( u32 i = 0 ; i < graph.size() ; i++ )
+			order.push_back(std::make_pair(graph[i].size(), i));
+		std::sort(order.begin(), order.end());
+
+		u32 nbEdges = 0;
+		for ( u32 i = 0 ; i < order.size() ; i++ )
+		{
+			u32 node = order[i].second;
+			if ( mates[node] != NO_NODE )
+				continue;
+
+			u32 best = NO_NODE;
+			std::set<u32>::const_iterator it;
+			for ( it = graph[node].begin() ; it != graph[node].end() ; ++it )
+			{
+				if ( mates[*it] == NO_NODE && (best == NO_NODE || graph[*it].size() < graph[best].size()) )
+					best = *it;
+			}
+			if ( best != NO_NODE )
+			{
+				mates[node] = best;
+				mates[best] = node;
+				nbEdges++;
+			}
+		}
+
+		// a node with no augmenting path won't get one later, one search per node is enough
+		for ( u32 i = 0 ; i < graph.size() ; i++ )
+		{
+			if ( mates[i] == NO_NODE && Grow(i) )
+				nbEdges++;
+		}
+		return nbEdges;
+	}
+};
+
+u32 FindMaximumMatching(const std::vector<std::set<u32> >& graph, std::vector<u32>& mates)
+{
+	Matching matching(graph, mates);
+	return matching.Build();
+}
+
+// A connected component of the dual graph, with its own node numbers
+struct Component
+{
+	std::vector<u32> nodes;					// dual graph node of each component node
+	std::vector<std::vector<u32> > paths;	// in dual graph nodes
+	u32 minPaths;
+};
+
+struct MatchingContext
+{
+	const std::vector<u32>* indices;
+	const std::vector<std::set<u32> >* graph;
+	std::vector<Component>* components;
+};
+
+// Paths of a component as links between nodes, joined through their ends
+struct ComponentLinks
+{
+	const std::vector<std::set<u32> >& graph;
+	const std::vector<u32>& indices;
+	const std::vector<u32>& nodes;
+	std::vector<u32> links;		// two per node
+	std::vector<u32> nbLinks;
+	std::vector<u32> ends;		// other end of the path, for the ends of a path
+
+	ComponentLinks(const std::vector<std::set<u32> >& componentGraph, const std::vector<u32>& triangles, const std::vector<u32>& componentNodes)
+	: graph(componentGraph)
+	, indices(triangles)
+	, nodes(componentNodes)
+	, links(graph.size() * 2)
+	, nbLinks(graph.size(), 0)
+	, ends(graph.size())
+	{
+		for ( u32 i = 0 ; i < graph.size() ; i++ )
+			ends[i] = i;
+	}
+
+	void Link(u32 a, u32 b)
+	{
+		u32 endA = ends[a];
+		u32 endB = ends[b];
+		ends[endA] = endB;
+		ends[endB] = endA;
+		links[a * 2 + nbLinks[a]++] = b;
+		links[b * 2 + nbLinks[b]++] = a;
+	}
+
+	// The node linked to node other than previous, NO_NODE if there's none
+	u32 GetNext(u32 node, u32 previous) const
+	{
+		if ( node == NO_NODE )
+			return NO_NODE;
+		if ( nbLinks[node] > 0 && links[node * 2] != previous )
+			return links[node * 2];
+		if ( nbLinks[node] > 1 && links[node * 2 + 1] != previous )
+			return links[node * 2 + 1];
+		return NO_NODE;
+	}
+
+	// Whether four triangles in a row turn around the same vertex, which a strip can only
+	// draw with a swap
+	bool IsFan(const u32* row) const
+	{
+		for ( u32 i = 0 ; i < 4 ; i++ )
+		{
+			if ( row[i] == NO_NODE )
+				return false;
+		}
+
+		const u32* triangles[4];
+		for ( u32 i = 0 ; i < 4 ; i++ )
+			triangles[i] = &indices[nodes[row[i]] * 3];
+		for ( u32 j = 0 ; j < 3 ; j++ )
+		{
+			u32 v = triangles[1][j];
+			if ( HasVertex(triangles[0], v) && HasVertex(triangles[2], v) && HasVertex(triangles[3], v) )
+				return true;
+		}
+		return false;
+	}
+
+	// Whether linking the path ends a and b makes a fan
+	bool MakesFan(u32 a, u32 b) const
+	{
+		u32 a1 = GetNext(a, NO_NODE);
+		u32 a2 = GetNext(a1, a);
+		u32 b1 = GetNext(b, NO_NODE);
+		u32 b2 = GetNext(b1, b);
+		u32 row[6] = { a2, a1, a, b, b1, b2 };
+		return IsFan(row) || IsFan(row + 1) || IsFan(row + 2);
+	}
+
+	// Links path ends, first where the strips go on without a swap
+	void Join()
+	{
+		for ( u32 pass = 0 ; pass < 2 ; pass++ )
+		{
+			for ( u32 a = 0 ; a < graph.size() ; a++ )
+			{
+				std::set<u32>::const_iterator it;
+				for ( it = graph[a].begin() ; it != graph[a].end() && nbLinks[a] < 2 ; ++it )
+				{
+					u32 b = *it;
+					if ( nbLinks[b] < 2 && ends[a] != b && (pass > 0 || ! MakesFan(a, b)) )
+						Link(a, b);
+				}
+			}
+		}
+	}
+};
+
+// Covers the matched pairs of a component with paths, joining them where their ends meet.
+// nodes gives the triangle of indices of each node of graph
+void BuildComponentPaths(const std::vector<std::set<u32> >& graph, const std::vector<u32>& indices, const std::vector<u32>& nodes,
+	std::vector<std::vector<u32> >& paths, u32& minPaths)
+{
+	std::vector<u32> mates;
+	u32 nbMatched = FindMaximumMatching(graph, mates);
+	minPaths = graph.size() > 2 * nbMatched ? graph.size() - 2 * nbMatched : 1;
+
+	ComponentLinks links(graph, indices, nodes);
+	for ( u32 i = 0 ; i < graph.size() ; i++ )
+	{
+		if ( mates[i] != NO_NODE && mates[i] > i )
+			links.Link(i, mates[i]);
+	}
+	links.Join();
+
+	paths.clear();
+	std::vector<bool> done(graph.size(), false);
+	for ( u32 node = 0 ; node < graph.size() ; node++ )
+	{
+		if ( done[node] || links.nbLinks[node] == 2 )
+			continue;
+
+		paths.push_back(std::vector<u32>());
+		u32 previous = node;
+		u32 current = node;
+		for ( ;; )
+		{
+			paths.back().push_back(current);
+			done[current] = true;
+			u32 next = links.GetNext(current, previous);
+			if ( next == NO_NODE )
+				break;
+			previous = current;
+			current = next;
+		}
+	}
+
+	TunnelPaths(graph, paths, MAX_TUNNEL_LENGTH);
+}
+
+void BuildComponentJob(u32 index, u32 /*worker*/, void* userData)
+{
+	MatchingContext* context = (MatchingContext*)userData;
+	const std::vector<std::set<u32> >& graph = *context->graph;
+	Component& component = (*context->components)[index];
+
+	// renumber the nodes of the component
+	std::vector<u32>& nodes = component.nodes;
+	std::sort(nodes.begin(), nodes.end());
+	std::vector<std::set<u32> > componentGraph(nodes.size());
+	for ( u32 i = 0 ; i < nodes.size() ; i++ )
+	{
+		std::set<u32>::const_iterator it;
+		for ( it = graph[nodes[i]].begin() ; it != graph[nodes[i]].end() ; ++it )
+			componentGraph[i].insert(std::lower_bound(nodes.begin(), nodes.end(), *it) - nodes.begin());
+	}
+
+	BuildComponentPaths(componentGraph, *context->indices, nodes, component.paths, component.minPaths);
+	for ( u32 p = 0 ; p < component.paths.size() ; p++ )
+	{
+		for ( u32 i = 0 ; i < component.paths[p].size() ; i++ )
+			component.paths[p][i] = nodes[component.paths[p][i]];
+	}
+}
+
+void BuildMatchingStrips(const std::vector<u32>& indices, PrimitiveGroups& strips, bool honorWinding, u32 nbThreads,
+	u32& nbPaths, u32& minPaths)
+{
+	std::vector<std::set<u32> > graph;
+	BuildDualGraph(indices, graph);
+
+	// connected components, the largest first so that they don't end up last on one thread
+	std::vector<Component> components;
+	std::vector<bool> found(graph.size(), false);
+	for ( u32 i = 0 ; i < graph.size() ; i++ )
+	{
+		if ( found[i] )
+			continue;
+
+		components.push_back(Component());
+		std::vector<u32>& nodes = components.back().nodes;
+		nodes.push_back(i);
+		found[i] = true;
+		for ( u32 j = 0 ; j < nodes.size() ; j++ )
+		{
+			std::set<u32>::const_iterator it;
+			for ( it = graph[nodes[j]].begin() ; it != graph[nodes[j]].end() ; ++it )
+			{
+				if ( ! found[*it] )
+				{
+					found[*it] = true;
+					nodes.push_back(*it);
+				}
+			}
+		}
+	}
+
+	std::vector<std::pair<u32, u32> > order;
+	for ( u32 c = 0 ; c < components.size() ; c++ )
+		order.push_back(std::make_pair(NO_NODE - components[c].nodes.size(), c));
+	std::sort(order.begin(), order.end());
+	std::vector<Component> sortedComponents(components.size());
+	for ( u32 c = 0 ; c < order.size() ; c++ )
+		sortedComponents[c].nodes.swap(components[order[c].second].nodes);
+
+	MatchingContext context;
+	context.indices = &indices;
+	context.graph = &graph;
+	context.components = &sortedComponents;
+	// no more workers than components, a single one being solved on this thread
+	u32 nbWorkers = nbThreads > 0 ? nbThreads : GetNbProcessors();
+	ThreadPool pool(std::max(1u, std::min(nbWorkers, (u32)sortedComponents.size())));
+	pool.Run(sortedComponents.size(), BuildComponentJob, &context);
+
+	nbPaths = 0;
+	minPaths = 0;
+	for ( u32 c = 0 ; c < sortedComponents.size() ; c++ )
+	{
+		const Component& component = sortedComponents[c];
+		for ( u32 p = 0 ; p < component.paths.size() ; p++ )
+			PathToStrips(component.paths[p], indices, strips, honorWinding);
+		nbPaths += component.paths.size();
+		minPaths += component.minPaths;
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef _MATCHING_H_
+#define _MATCHING_H_
+
+#include <vector>
+#include <set>
+#include "types.h"
+#include "stripper.h"
+
+// Edges in a maximum matching of graph, found with Edmonds' blossom algorithm. mates gets
+// the node each node is matched with, or 0xFFFFFFFF if it isn't
+u32 FindMaximumMatching(const std::vector<std::set<u32> >& graph, std::vector<u32>& mates);
+
+// Strips from a maximum matching of the dual graph of indices: every matched pair of triangles
+// starts a path, the paths are joined through their ends and then tunneled. Connected components
+// of the dual graph are handled on up to nbThreads threads, 0 for one per processor.
+//
+// A path cover of n nodes with k edges can't beat n - k paths, and its edges split into two
+// matchings, so a component with a maximum matching of M edges needs at least n - 2M paths.
+// nbPaths gets the number of paths found, and minPaths the sum of these bounds
+void BuildMatchingStrips(const std::vector<u32>& indices, PrimitiveGroups& strips, bool honorWinding, u32 nbThreads,
+	u32& nbPaths, u32& minPaths);
+
+#endif // _MATCHING_H_
@@ -0,0 +1,259 @@
+#include "optimizer.h"
+#include <time.h>
+#include <set>
+#include <algorithm>
+#include "stripping.h"
+
+typedef std::vector<u32> Path;
+
+static const u32 NO_PATH = 0xFFFFFFFF;
+
+// Paths of the dual graph drawn as strips, and the moves improving them
+struct PathOptimizer
+{
+	const std::vector<u32>& indices;
+	const CostModel& cost;
+	bool honorWinding;
+	std::vector<std::set<u32> > graph;
+	std::vector<Path> paths;			// empty when unused
+	std::vector<u32> pathCosts;
+	std::vector<u32> freePaths;
+	std::vector<u32> nodePaths;			// path of each triangle, NO_PATH if it isn't optimized
+	std::vector<u32> nodePositions;		// position of each triangle in its path
+	std::vector<u32> nodes;				// triangles being optimized
+	u32 totalCost;
+	u32 seed;
+
+	PathOptimizer(const std::vector<u32>& triangles, const CostModel& model, bool winding)
+	: indices(triangles)
+	, cost(model)
+	, honorWinding(winding)
+	, totalCost(0)
+	, seed(0x12345678)
+	{
+		BuildDualGraph(indices, graph);
+		nodePaths.assign(graph.size(), NO_PATH);
+		nodePositions.assign(graph.size(), 0);
+	}
+
+	// xorshift, the same sequence on every run
+	u32 Random(u32 range)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed % range;
+	}
+
+	u32 GetCost(const Path& path) const
+	{
+		PrimitiveGroups strips;
+		PathToStrips(path, indices, strips, honorWinding);
+		return cost.GetCost(strips);
+	}
+
+	// Takes the nodes of path, which is left empty
+	void AddPath(Path& path, u32 pathCost)
+	{
+		u32 p;
+		if ( freePaths.size() > 0 )
+		{
+			p = freePaths.back();
+			freePaths.pop_back();
+		}
+		else
+		{
+			p = paths.size();
+			paths.push_back(Path());
+			pathCosts.push_back(0);
+		}
+
+		paths[p].swap(path);
+		path.clear();
+		pathCosts[p] = pathCost;
+		totalCost += pathCost;
+		for ( u32 i = 0 ; i < paths[p].size() ; i++ )
+		{
+			nodePaths[paths[p][i]] = p;
+			nodePositions[paths[p][i]] = i;
+		}
+	}
+
+	void RemovePath(u32 p)
+	{
+		totalCost -= pathCosts[p];
+		paths[p].clear();
+		freePaths.push_back(p);
+	}
+
+	// Reads the paths followed by the triangle strips and lists of groups and tunnels them,
+	// moves the other primitives to others
+	void Init(const PrimitiveGroups& groups, PrimitiveGroups& others)
+	{
+		std::vector<Path> startPaths;
+		GetPrimitivePaths(groups, indices, graph, startPaths, others);
+		TunnelPaths(graph, startPaths, MAX_TUNNEL_LENGTH);
+		for ( u32 p = 0 ; p < startPaths.size() ; p++ )
+		{
+			nodes.insert(nodes.end(), startPaths[p].begin(), startPaths[p].end());
+			AddPath(startPaths[p], GetCost(startPaths[p]));
+		}
+	}
+
+	// Splits the path of node so that node ends a piece, after its previous node or before its next one
+	void Cut(u32 node, bool after, std::vector<u32>& cuts) const
+	{
+		u32 position = nodePositions[node];
+		if ( after && position + 1 < paths[nodePaths[node]].size() )
+			cuts.push_back(position + 1);
+		else if ( ! after && position > 0 )
+			cuts.push_back(position);
+	}
+
+	// Appends the pieces of path p split before the positions in cuts
+	void Split(u32 p, std::vector<u32>& cuts, std::vector<Path>& pieces) const
+	{
+		std::sort(cuts.begin(), cuts.end());
+		const Path& path = paths[p];
+		u32 start = 0;
+		for ( u32 i = 0 ; i <= cuts.size() ; i++ )
+		{
+			u32 end = i < cuts.size() ? cuts[i] : path.size();
+			if ( end > start )
+				pieces.push_back(Path(path.begin() + start, path.begin() + end));
+			start = end;
+		}
+	}
+
+	// Links neighbour triangles a and b, cutting their paths on random sides.
+	// Keeps the result if it costs no more than before
+	bool Link(u32 a, u32 b)
+	{
+		u32 pa = nodePaths[a];
+		u32 pb = nodePaths[b];
+		if ( pa == pb && (nodePositions[a] + 1 == nodePositions[b] || nodePositions[b] + 1 == nodePositions[a]) )
+			return false;
+
+		std::vector<u32> cutsA, cutsB;
+		Cut(a, Random(2) == 0, cutsA);
+		Cut(b, Random(2) == 0, pa == pb ? cutsA : cutsB);
+
+		std::vector<Path> pieces;
+		Split(pa, cutsA, pieces);
+		if ( pb != pa )
+			Split(pb, cutsB, pieces);
+
+		u32 pieceA = 0, pieceB = 0;
+		for ( u32 i = 0 ; i < pieces.size() ; i++ )
+		{
+			if ( std::find(pieces[i].begin(), pieces[i].end(), a) != pieces[i].end() )
+				pieceA = i;
+			if ( std::find(pieces[i].begin(), pieces[i].end(), b) != pieces[i].end() )
+				pieceB = i;
+		}
+		if ( pieceA == pieceB ) // would be a loop
+			return false;
+
+		// a ends its piece and b starts its own
+		if ( pieces[pieceA].front() == a )
+			std::reverse(pieces[pieceA].begin(), pieces[pieceA].end());
+		if ( pieces[pieceB].back() == b )
+			std::reverse(pieces[pieceB].begin(), pieces[pieceB].end());
+		pieces[pieceA].insert(pieces[pieceA].end(), pieces[pieceB].begin(), pieces[pieceB].end());
+		pieces.erase(pieces.begin() + pieceB);
+
+		u32 oldCost = pathCosts[pa] + (pb != pa ? pathCosts[pb] : 0);
+		u32 newCost = 0;
+		std::vector<u32> pieceCosts(pieces.size());
+		for ( u32 i = 0 ; i < pieces.size() && newCost <= oldCost ; i++ )
+		{
+			pieceCosts[i] = GetCost(pieces[i]);
+			newCost += pieceCosts[i];
+		}
+		if ( newCost > oldCost )
+			return false;
+
+		RemovePath(pa);
+		if ( pb != pa )
+			RemovePath(pb);
+		for ( u32 i = 0 ; i < pieces.size() ; i++ )
+			AddPath(pieces[i], pieceCosts[i]);
+		return true;
+	}
+
+	// Reverses the path of node, which starts its strips from the other end
+	bool Reverse(u32 node)
+	{
+		u32 p = nodePaths[node];
+		Path path(paths[p].rbegin(), paths[p].rend());
+		u32 pathCost = GetCost(path);
+		if ( pathCost >= pathCosts[p] )
+			return false;
+
+		RemovePath(p);
+		AddPath(path, pathCost);
+		return true;
+	}
+
+	void Optimize(float seconds)
+	{
+		if ( nodes.empty() )
+			return;
+
+		clock_t end = clock() + clock_t(seconds * CLOCKS_PER_SEC);
+		do
+		{
+			// check the time every few moves only
+			for ( u32 i = 0 ; i < 64 ; i++ )
+			{
+				u32 node = nodes[Random(nodes.size())];
+				if ( Random(8) == 0 )
+				{
+					Reverse(node);
+					continue;
+				}
+
+				const std::set<u32>& neighbours = graph[node];
+				if ( neighbours.empty() )
+					continue;
+				std::set<u32>::const_iterator it = neighbours.begin();
+				std::advance(it, Random(neighbours.size()));
+				if ( nodePaths[*it] != NO_PATH )
+					Link(node, *it);
+			}
+		}
+		while ( clock() < end );
+	}
+
+	void GetStrips(PrimitiveGroups& strips) const
+	{
+		for ( u32 p = 0 ; p < paths.size() ; p++ )
+		{
+			if ( paths[p].size() > 0 )
+				PathToStrips(paths[p], indices, strips, honorWinding);
+		}
+	}
+};
+
+u32 OptimizeStrips(PrimitiveGroups& groups, const std::vector<u32>& indices, const CostModel& cost, float seconds, bool honorWinding)
+{
+	PathOptimizer optimizer(indices, cost, honorWinding);
+	PrimitiveGroups optimized;
+	optimizer.Init(groups, optimized);
+	optimizer.Optimize(seconds);
+
+	PrimitiveGroups strips;
+	optimizer.GetStrips(strips);
+	StitchStrips(strips, cost);
+	BatchTriangles(strips, cost);
+	optimized.Add(strips);
+
+	// the paths are drawn again, which may not be as good as the strips they started from
+	u32 startCost = cost.GetCost(groups);
+	u32 optimizedCost = cost.GetCost(optimized);
+	if ( optimizedCost >= startCost )
+		return 0;
+
+	groups = optimized;
+	return startCost - optimizedCost;
+}
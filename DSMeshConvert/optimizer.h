@@ -0,0 +1,15 @@
+#ifndef _OPTIMIZER_H_
+#define _OPTIMIZER_H_
+
+#include <vector>
+#include "types.h"
+#include "primitives.h"
+
+// Improves the triangle strips and lists of groups, drawing the triangles of indices, with
+// moves on the paths they follow in the dual graph: tunneling first, then local moves until
+// seconds have passed, linking two neighbour triangles by splitting their paths and merging
+// the pieces, and reversing paths. Other primitives are kept as they are. With honorWinding,
+// the new strips draw every triangle with its winding in indices. Returns the bytes saved
+u32 OptimizeStrips(PrimitiveGroups& groups, const std::vector<u32>& indices, const CostModel& cost, float seconds, bool honorWinding);
+
+#endif // _OPTIMIZER_H_
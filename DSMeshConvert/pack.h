@@ -0,0 +1,51 @@
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include "types.h"
+
+// A pack holds the display lists of several meshes in one file, for the runtime to load in one
+// read and the host tools to map as is. It's a PackHeader, then nbEntries PackEntry, then the
+// display lists, each one starting at a multiple of PACK_ALIGNMENT bytes from the start of the
+// file so that it can be sent by DMA from where it was loaded, or be decompressed from there
+// by the BIOS when it's compressed. Everything is little-endian.
+
+static const u32 PACK_MAGIC = 'D' | ('S' << 8) | ('M' << 16) | ('P' << 24);
+static const u32 PACK_VERSION = 4;
+static const u32 PACK_ALIGNMENT = 32;
+static const u32 PACK_NAME_LENGTH = 32;
+
+struct PackHeader
+{
+	u32 magic;
+	u32 version;
+	u32 nbEntries;
+	u32 size;						// of the whole pack, padding included
+};
+
+struct PackEntry
+{
+	char name[PACK_NAME_LENGTH];	// zero-terminated
+	u32 offset;						// of the display list, from the start of the pack
+	u32 size;						// of the display list, in bytes
+	u32 compression;				// format of the display list for the DS BIOS decompressors
+									// (CompressionType), 0 if it's as it is
+	u32 chunkSize;					// most bytes in a chunk of the display list once
+									// decompressed (see chunks.h), 0 if it's in one piece
+	u32 nbTriangles;
+	u32 nbPrimitives;
+	u32 lod;						// level of detail, 0 for the full mesh, the levels of a mesh
+									// following each other under its name
+	float error;					// how far the level is from the full mesh, in model units
+	float boxMin[3];				// bounding box of the mesh
+	float boxMax[3];
+	float scale[3];					// quantization: a vertex of the display list is
+	float translate[3];				// model * scale + translate, before its 4.6 rounding
+};
+
+// Offset rounded up to the next display list
+inline u32 AlignPackOffset(u32 offset)
+{
+	return (offset + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+}
+
+#endif // _PACK_H_
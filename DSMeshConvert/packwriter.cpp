@@ -0,0 +1,39 @@
+#include "packwriter.h"
+#include <stdio.h>
+
+bool WritePack(const char* path, std::vector<PackEntry>& entries, const std::vector<std::vector<u32> >& lists)
+{
+	PackHeader header;
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.nbEntries = entries.size();
+
+	u32 offset = sizeof(PackHeader) + entries.size() * sizeof(PackEntry);
+	for ( u32 i = 0 ; i < entries.size() ; i++ )
+	{
+		entries[i].offset = AlignPackOffset(offset);
+		entries[i].size = lists[i].size() * sizeof(u32);
+		offset = entries[i].offset + entries[i].size;
+	}
+	header.size = AlignPackOffset(offset);
+
+	FILE* f = fopen(path, "wb");
+	if ( f == 0 )
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	if ( ok && entries.size() > 0 )
+		ok = fwrite(&entries[0], sizeof(PackEntry), entries.size(), f) == entries.size();
+
+	static const u8 padding[PACK_ALIGNMENT] = { 0 };
+	offset = sizeof(PackHeader) + entries.size() * sizeof(PackEntry);
+	for ( u32 i = 0 ; ok && i <= entries.size() ; i++ )
+	{
+		u32 next = i < entries.size() ? entries[i].offset : header.size;
+		ok = fwrite(padding, 1, next - offset, f) == next - offset;
+		if ( ok && i < entries.size() && entries[i].size > 0 )
+			ok = fwrite(&lists[i][0], 1, entries[i].size, f) == entries[i].size;
+		offset = next + (i < entries.size() ? entries[i].size : 0);
+	}
+	return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,12 @@
+#ifndef _PACKWRITER_H_
+#define _PACKWRITER_H_
+
+#include <vector>
+#include "types.h"
+#include "pack.h"
+
+// Writes the display lists in a pack at path, entries[i] describing lists[i]. The offsets and
+// sizes of the entries are set by the writer
+bool WritePack(const char* path, std::vector<PackEntry>& entries, const std::vector<std::vector<u32> >& lists);
+
+#endif // _PACKWRITER_H_
@@ -0,0 +1,164 @@
+#include "prefetch.h"
+#include <stdio.h>
+#include <string.h>
+#include <IOStream.h>
+
+bool ReadWholeFile(const char* path, std::vector<char>& data)
+{
+	FILE* f = fopen(path, "rb");
+	if ( f == 0 )
+		return false;
+
+	bool ok = fseek(f, 0, SEEK_END) == 0;
+	long size = ok ? ftell(f) : -1;
+	ok = size >= 0 && fseek(f, 0, SEEK_SET) == 0;
+	if ( ok )
+	{
+		data.resize(size);
+		ok = size == 0 || fread(&data[0], 1, size, f) == size_t(size);
+	}
+	fclose(f);
+	return ok;
+}
+
+// Reads from memory, writes aren't supported
+class MemoryStream : public Assimp::IOStream
+{
+public:
+	MemoryStream(const std::vector<char>& data)
+	: mData(data)
+	, mPosition(0)
+	{
+	}
+
+	size_t Read(void* buffer, size_t size, size_t count)
+	{
+		if ( size == 0 )
+			return 0;
+		size_t available = (mData.size() - mPosition) / size;
+		if ( count > available )
+			count = available;
+		if ( count > 0 )
+			memcpy(buffer, &mData[mPosition], size * count);
+		mPosition += size * count;
+		return count;
+	}
+
+	size_t Write(const void*, size_t, size_t)
+	{
+		return 0;
+	}
+
+	aiReturn Seek(size_t offset, aiOrigin origin)
+	{
+		size_t position;
+		if ( origin == aiOrigin_SET )
+			position = offset;
+		else if ( origin == aiOrigin_CUR )
+			position = mPosition + offset;
+		else
+			position = mData.size() + offset;	// as fseek() does, a negative offset wrapped to a size_t
+		if ( position > mData.size() )
+			return aiReturn_FAILURE;
+		mPosition = position;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t Tell() const { return mPosition; }
+	size_t FileSize() const { return mData.size(); }
+	void Flush() {}
+
+private:
+	const std::vector<char>& mData;
+	size_t mPosition;
+};
+
+// A file opened from the disk, for whatever wasn't read ahead
+class DiskStream : public Assimp::IOStream
+{
+public:
+	DiskStream(FILE* file)
+	: mFile(file)
+	{
+	}
+
+	~DiskStream()
+	{
+		fclose(mFile);
+	}
+
+	size_t Read(void* buffer, size_t size, size_t count)
+	{
+		return fread(buffer, size, count, mFile);
+	}
+
+	size_t Write(const void* buffer, size_t size, size_t count)
+	{
+		return fwrite(buffer, size, count, mFile);
+	}
+
+	aiReturn Seek(size_t offset, aiOrigin origin)
+	{
+		int whence = origin == aiOrigin_SET ? SEEK_SET : origin == aiOrigin_CUR ? SEEK_CUR : SEEK_END;
+		return fseek(mFile, long(offset), whence) == 0 ? aiReturn_SUCCESS : aiReturn_FAILURE;
+	}
+
+	size_t Tell() const
+	{
+		return ftell(mFile);
+	}
+
+	size_t FileSize() const
+	{
+		long position = ftell(mFile);
+		fseek(mFile, 0, SEEK_END);
+		long size = ftell(mFile);
+		fseek(mFile, position, SEEK_SET);
+		return size;
+	}
+
+	void Flush()
+	{
+		fflush(mFile);
+	}
+
+private:
+	FILE* mFile;
+};
+
+PrefetchIOSystem::PrefetchIOSystem(const char* path, const std::vector<char>& data)
+: mPath(path)
+, mData(data)
+{
+}
+
+bool PrefetchIOSystem::Exists(const char* file) const
+{
+	if ( mPath == file )
+		return true;
+
+	FILE* f = fopen(file, "rb");
+	if ( f == 0 )
+		return false;
+	fclose(f);
+	return true;
+}
+
+char PrefetchIOSystem::getOsSeparator() const
+{
+	return '\\';
+}
+
+Assimp::IOStream* PrefetchIOSystem::Open(const char* file, const char* mode)
+{
+	if ( strchr(mode, 'w') == 0 && mPath == file )
+		return new MemoryStream(mData);
+
+	FILE* f = fopen(file, mode);
+	return f != 0 ? new DiskStream(f) : 0;
+}
+
+void PrefetchIOSystem::Close(Assimp::IOStream* stream)
+{
+	delete stream;
+}
@@ -0,0 +1,30 @@
+#ifndef _PREFETCH_H_
+#define _PREFETCH_H_
+
+#include <string>
+#include <vector>
+#include <IOSystem.h>
+#include "types.h"
+
+// Reads the whole of path into data, returns false if it can't be read
+bool ReadWholeFile(const char* path, std::vector<char>& data);
+
+// Gives Assimp a file already read into memory, so that importing it doesn't wait on the
+// disk. Any other file, such as a material library, is opened from the disk as usual.
+// data isn't copied and has to outlive the importer's use of the handler
+class PrefetchIOSystem : public Assimp::IOSystem
+{
+public:
+	PrefetchIOSystem(const char* path, const std::vector<char>& data);
+
+	bool Exists(const char* file) const;
+	char getOsSeparator() const;
+	Assimp::IOStream* Open(const char* file, const char* mode = "rb");
+	void Close(Assimp::IOStream* stream);
+
+private:
+	std::string mPath;
+	const std::vector<char>& mData;
+};
+
+#endif // _PREFETCH_H_
@@ -0,0 +1,433 @@
+#include "primitives.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+
+CostModel::CostModel(u32 nbVertexCommands)
+: beginCost(5)
+, vertexCost(5 * nbVertexCommands)
+, repeatCost(5)
+{
+}
+
+u32 CostModel::GetCost(u32 previous, const u32* indices, u32 count) const
+{
+	u32 cost = 0;
+	for ( u32 i = 0 ; i < count ; i++ )
+	{
+		cost += GetVertexCost(previous, indices[i]);
+		previous = indices[i];
+	}
+	return cost;
+}
+
+u32 CostModel::GetCost(const PrimitiveGroups& groups) const
+{
+	u32 cost = 0;
+	const u32* indices = groups.indices.size() > 0 ? &groups.indices[0] : 0;
+	for ( u32 i = 0 ; i < groups.GetNbPrimitives() ; i++ )
+	{
+		cost += beginCost + GetCost(NO_INDEX, indices, groups.lengths[i]);
+		indices += groups.lengths[i];
+	}
+	return cost;
+}
+
+typedef std::vector<u32> Strip;
+
+// How a strip gets appended to a chain of strips
+struct Join
+{
+	u32 saving;			// bytes saved compared to a new primitive
+	u32 strip;
+	bool reversed;
+	bool overlap;		// the strip starts with the last two vertices of the chain
+	u32 bridge[3];		// vertices inserted between the chain and the strip otherwise
+	u32 bridgeLength;
+};
+
+bool IsDegenerate(u32 a, u32 b, u32 c)
+{
+	return a == b || a == c || b == c;
+}
+
+// Bytes saved by appending strip to chain through bridge, 0 if a triangle in between
+// isn't degenerate or if the triangles of strip would change winding
+u32 GetBridgeSaving(const Strip& chain, const Strip& strip, const u32* bridge, u32 bridgeLength, const CostModel& cost)
+{
+	if ( (chain.size() + bridgeLength) % 2 != 0 )
+		return 0;
+
+	u32 vertices[7];
+	u32 nbVertices = 0;
+	vertices[nbVertices++] = chain[chain.size() - 2];
+	vertices[nbVertices++] = chain[chain.size() - 1];
+	for ( u32 i = 0 ; i < bridgeLength ; i++ )
+		vertices[nbVertices++] = bridge[i];
+	vertices[nbVertices++] = strip[0];
+	vertices[nbVertices++] = strip[1];
+	for ( u32 i = 0 ; i + 2 < nbVertices ; i++ )
+	{
+		if ( ! IsDegenerate(vertices[i], vertices[i + 1], vertices[i + 2]) )
+			return 0;
+	}
+
+	// past its first vertex, the strip costs the same either way
+	u32 separate = cost.beginCost + cost.GetCost(NO_INDEX, &strip[0], 1);
+	u32 joined = cost.GetCost(chain.back(), bridge, bridgeLength)
+		+ cost.GetCost(vertices[nbVertices - 3], &strip[0], 1);
+	return joined < separate ? separate - joined : 0;
+}
+
+// Finds the cheapest way to append strip to chain, returns false if none saves anything
+bool EvaluateJoin(const Strip& chain, const Strip& strip, const CostModel& cost, Join& join)
+{
+	join.saving = 0;
+
+	u32 last = chain.back();
+	if ( chain[chain.size() - 2] == strip[0] && last == strip[1] && chain.size() % 2 == 0 )
+	{
+		join.saving = cost.beginCost + cost.GetCost(NO_INDEX, &strip[0], 2);
+		join.overlap = true;
+		return true;
+	}
+
+	const u32 bridges[4][3] = {
+		{ 0, 0, 0 },
+		{ last, 0, 0 },
+		{ last, strip[0], 0 },
+		{ last, last, strip[0] },
+	};
+	for ( u32 i = 0 ; i < 4 ; i++ )
+	{
+		u32 saving = GetBridgeSaving(chain, strip, bridges[i], i, cost);
+		if ( saving > join.saving )
+		{
+			join.saving = saving;
+			join.overlap = false;
+			join.bridge[0] = bridges[i][0];
+			join.bridge[1] = bridges[i][1];
+			join.bridge[2] = bridges[i][2];
+			join.bridgeLength = i;
+		}
+	}
+	return join.saving > 0;
+}
+
+void StitchStrips(PrimitiveGroups& groups, const CostModel& cost)
+{
+	// other primitives go first, as they are
+	PrimitiveGroups result;
+	std::vector<Strip> strips;
+	const u32* indices = groups.indices.size() > 0 ? &groups.indices[0] : 0;
+	for ( u32 i = 0 ; i < groups.GetNbPrimitives() ; i++ )
+	{
+		if ( groups.types[i] == PRIM_TRIANGLE_STRIP && groups.lengths[i] >= 3 )
+			strips.push_back(Strip(indices, indices + groups.lengths[i]));
+		else
+			result.Add(groups.types[i], indices, groups.lengths[i]);
+		indices += groups.lengths[i];
+	}
+
+	// a strip with an even number of vertices keeps its winding when reversed
+	std::vector<Strip> reversedStrips(strips.size());
+	for ( u32 i = 0 ; i < strips.size() ; i++ )
+	{
+		if ( strips[i].size() % 2 == 0 )
+			reversedStrips[i].assign(strips[i].rbegin(), strips[i].rend());
+	}
+
+	// strips starting with a vertex, which can follow a chain ending with it or with it and another vertex
+	std::map<u32, std::vector<std::pair<u32, bool> > > starts;
+	for ( u32 i = 0 ; i < strips.size() ; i++ )
+	{
+		starts[strips[i].front()].push_back(std::make_pair(i, false));
+		if ( reversedStrips[i].size() > 0 )
+			starts[reversedStrips[i].front()].push_back(std::make_pair(i, true));
+	}
+
+	// any two strips could be joined if two degenerate vertices cost less than a new primitive
+	bool joinAny = cost.beginCost > 2 * cost.repeatCost;
+
+	std::vector<bool> used(strips.size(), false);
+	u32 firstUnused = 0;
+	for ( u32 i = 0 ; i < strips.size() ; i++ )
+	{
+		if ( used[i] )
+			continue;
+
+		Strip chain = strips[i];
+		used[i] = true;
+		for ( ;; )
+		{
+			Join best;
+			best.saving = 0;
+
+			for ( u32 j = 0 ; j < 2 ; j++ )
+			{
+				std::map<u32, std::vector<std::pair<u32, bool> > >::iterator it = starts.find(chain[chain.size() - 1 - j]);
+				if ( it == starts.end() )
+					continue;
+
+				for ( u32 k = 0 ; k < it->second.size() ; k++ )
+				{
+					u32 strip = it->second[k].first;
+					bool reversed = it->second[k].second;
+					Join join;
+					if ( ! used[strip] && EvaluateJoin(chain, reversed ? reversedStrips[strip] : strips[strip], cost, join) && join.saving > best.saving )
+					{
+						best = join;
+						best.strip = strip;
+						best.reversed = reversed;
+					}
+				}
+			}
+
+			if ( best.saving == 0 && joinAny )
+			{
+				while ( firstUnused < strips.size() && used[firstUnused] )
+					firstUnused++;
+
+				Join join;
+				if ( firstUnused < strips.size() && EvaluateJoin(chain, strips[firstUnused], cost, join) )
+				{
+					best = join;
+					best.strip = firstUnused;
+					best.reversed = false;
+				}
+			}
+
+			if ( best.saving == 0 )
+				break;
+
+			const Strip& strip = best.reversed ? reversedStrips[best.strip] : strips[best.strip];
+			if ( best.overlap )
+			{
+				chain.insert(chain.end(), strip.begin() + 2, strip.end());
+			}
+			else
+			{
+				chain.insert(chain.end(), best.bridge, best.bridge + best.bridgeLength);
+				chain.insert(chain.end(), strip.begin(), strip.end());
+			}
+			used[best.strip] = true;
+		}
+
+		result.Add(PRIM_TRIANGLE_STRIP, &chain[0], chain.size());
+	}
+
+	groups = result;
+}
+
+// Appends a triangle to a triangle list, starting with the last vertex of the list if it has it
+void AddListTriangle(std::vector<u32>& list, u32 a, u32 b, u32 c)
+{
+	if ( list.size() > 0 && list.back() == b )
+	{
+		u32 t = a; a = b; b = c; c = t;
+	}
+	else if ( list.size() > 0 && list.back() == c )
+	{
+		u32 t = c; c = b; b = a; a = t;
+	}
+	list.push_back(a);
+	list.push_back(b);
+	list.push_back(c);
+}
+
+// Appends the triangles of a primitive to a triangle list, with their winding
+void AddListTriangles(std::vector<u32>& list, u32 type, const u32* indices, u32 count)
+{
+	if ( type == PRIM_TRIANGLES )
+	{
+		for ( u32 i = 0 ; i + 2 < count ; i += 3 )
+			AddListTriangle(list, indices[i], indices[i + 1], indices[i + 2]);
+	}
+	else // if ( type == PRIM_TRIANGLE_STRIP )
+	{
+		for ( u32 i = 0 ; i + 2 < count ; i++ )
+		{
+			if ( IsDegenerate(indices[i], indices[i + 1], indices[i + 2]) )
+				continue;
+			if ( i % 2 == 0 )
+				AddListTriangle(list, indices[i], indices[i + 1], indices[i + 2]);
+			else
+				AddListTriangle(list, indices[i + 1], indices[i], indices[i + 2]);
+		}
+	}
+}
+
+void BatchTriangles(PrimitiveGroups& groups, const CostModel& cost)
+{
+	PrimitiveGroups batched;
+	std::vector<u32> list;
+	const u32* indices = groups.indices.size() > 0 ? &groups.indices[0] : 0;
+	for ( u32 i = 0 ; i < groups.GetNbPrimitives() ; i++ )
+	{
+		u32 type = groups.types[i];
+		u32 count = groups.lengths[i];
+		bool move = type == PRIM_TRIANGLES;
+		if ( type == PRIM_TRIANGLE_STRIP )
+		{
+			// compare the cost of the strip with the cost of its triangles at the end of the list
+			u32 listSize = list.size();
+			AddListTriangles(list, type, indices, count);
+			u32 previous = listSize > 0 ? list[listSize - 1] : NO_INDEX;
+			const u32* added = list.empty() ? 0 : &list[0] + listSize;	// nothing when all its triangles are degenerate
+			u32 listCost = cost.GetCost(previous, added, list.size() - listSize);
+			move = listCost < cost.beginCost + cost.GetCost(NO_INDEX, indices, count);
+			list.resize(listSize);
+		}
+
+		if ( move )
+			AddListTriangles(list, type, indices, count);
+		else
+			batched.Add(type, indices, count);
+		indices += count;
+	}
+
+	if ( list.empty() )
+		return;
+
+	// the list needs its own primitive, which may cost more than it saved
+	batched.Add(PRIM_TRIANGLES, &list[0], list.size());
+	if ( cost.GetCost(batched) < cost.GetCost(groups) )
+		groups = batched;
+}
+
+// Vertices of a triangle in increasing order
+struct SortedTriangle
+{
+	u32 v[3];
+
+	bool operator<(const SortedTriangle& other) const
+	{
+		return std::lexicographical_compare(v, v + 3, other.v, other.v + 3);
+	}
+};
+
+static const u32 WINDING_EVEN = 1;	// sorting the vertices takes an even number of swaps
+static const u32 WINDING_ODD = 2;
+
+u32 SortTriangle(u32 a, u32 b, u32 c, SortedTriangle& sorted)
+{
+	u32 winding = WINDING_EVEN;
+	if ( a > b ) { std::swap(a, b); winding ^= 3; }
+	if ( b > c ) { std::swap(b, c); winding ^= 3; }
+	if ( a > b ) { std::swap(a, b); winding ^= 3; }
+	sorted.v[0] = a;
+	sorted.v[1] = b;
+	sorted.v[2] = c;
+	return winding;
+}
+
+// Windings of the triangles of a mesh, both of them for a triangle it has both ways
+struct Windings
+{
+	std::map<SortedTriangle, u32> windings;
+
+	Windings(const std::vector<u32>& triangles)
+	{
+		for ( u32 i = 0 ; i + 2 < triangles.size() ; i += 3 )
+		{
+			SortedTriangle sorted;
+			u32 winding = SortTriangle(triangles[i], triangles[i + 1], triangles[i + 2], sorted);
+			windings[sorted] |= winding;
+		}
+	}
+
+	// Whether (a, b, c) is drawn reversed, false for triangles which aren't in the mesh
+	bool IsReversed(u32 a, u32 b, u32 c) const
+	{
+		SortedTriangle sorted;
+		u32 winding = SortTriangle(a, b, c, sorted);
+		std::map<SortedTriangle, u32>::const_iterator it = windings.find(sorted);
+		return it != windings.end() && (it->second & winding) == 0;
+	}
+
+	// Whether the triangle of strip at position i is drawn reversed, degenerate triangles never are
+	bool IsReversed(const u32* strip, u32 i) const
+	{
+		if ( IsDegenerate(strip[i], strip[i + 1], strip[i + 2]) )
+			return false;
+		if ( i % 2 == 0 )
+			return IsReversed(strip[i], strip[i + 1], strip[i + 2]);
+		return IsReversed(strip[i + 1], strip[i], strip[i + 2]);
+	}
+};
+
+void EnforceWinding(PrimitiveGroups& groups, const std::vector<u32>& triangles)
+{
+	Windings windings(triangles);
+
+	PrimitiveGroups result;
+	std::vector<u32> fixed;
+	const u32* indices = groups.indices.size() > 0 ? &groups.indices[0] : 0;
+	for ( u32 p = 0 ; p < groups.GetNbPrimitives() ; p++ )
+	{
+		u32 type = groups.types[p];
+		u32 count = groups.lengths[p];
+		if ( count == 0 )
+			continue;
+		const u32* primitive = indices;
+		indices += count;
+		fixed.assign(primitive, primitive + count);
+
+		if ( type == PRIM_TRIANGLES )
+		{
+			for ( u32 i = 0 ; i + 2 < count ; i += 3 )
+			{
+				if ( windings.IsReversed(fixed[i], fixed[i + 1], fixed[i + 2]) )
+					std::swap(fixed[i + 1], fixed[i + 2]);
+			}
+		}
+		else if ( type == PRIM_TRIANGLE_STRIP && count >= 3 )
+		{
+			u32 nbTriangles = 0, nbReversed = 0;
+			for ( u32 i = 0 ; i + 2 < count ; i++ )
+			{
+				if ( ! IsDegenerate(fixed[i], fixed[i + 1], fixed[i + 2]) )
+					nbTriangles++;
+				if ( windings.IsReversed(&fixed[0], i) )
+					nbReversed++;
+			}
+
+			// reversing a strip with an odd number of vertices reverses all its triangles
+			if ( nbReversed > 0 && nbReversed == nbTriangles && count % 2 == 1 )
+			{
+				std::reverse(fixed.begin(), fixed.end());
+			}
+			else if ( nbReversed > 0 )
+			{
+				// a new strip starts at every triangle drawn reversed, which costs no more than
+				// degenerate triangles changing the parity, and then only needs one if the
+				// triangle is still reversed
+				fixed.assign(primitive, primitive + 2);
+				bool drawn = false;
+				for ( u32 i = 0 ; i + 2 < count ; i++ )
+				{
+					u32 a = primitive[i];
+					u32 b = primitive[i + 1];
+					u32 c = primitive[i + 2];
+					fixed.push_back(c);
+					if ( windings.IsReversed(&fixed[0], fixed.size() - 3) )
+					{
+						if ( drawn )
+						{
+							fixed.pop_back();
+							result.Add(type, &fixed[0], fixed.size());
+							fixed.assign(primitive + i, primitive + i + 3);
+						}
+						if ( windings.IsReversed(&fixed[0], fixed.size() - 3) )
+							fixed.insert(fixed.end() - 3, a);
+					}
+					drawn = drawn || ! IsDegenerate(a, b, c);
+				}
+			}
+		}
+
+		result.Add(type, &fixed[0], fixed.size());
+	}
+
+	groups = result;
+}
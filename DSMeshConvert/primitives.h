@@ -0,0 +1,43 @@
+#ifndef _PRIMITIVES_H_
+#define _PRIMITIVES_H_
+
+#include "types.h"
+#include "stripper.h"
+
+// Size of primitives in the display list, in bytes: every command takes one byte of a
+// packed command word plus its parameter word, see PushValue in main.cpp
+struct CostModel
+{
+	// nbVertexCommands: commands sent for each vertex, the position included
+	CostModel(u32 nbVertexCommands);
+
+	u32 beginCost;		// BEGIN_VTXS
+	u32 vertexCost;		// every command of a vertex
+	u32 repeatCost;		// a vertex repeating the previous one only needs its position
+
+	u32 GetVertexCost(u32 previous, u32 index) const { return index == previous ? repeatCost : vertexCost; }
+
+	// Cost of count indices emitted after previous, in the same primitive
+	u32 GetCost(u32 previous, const u32* indices, u32 count) const;
+
+	u32 GetCost(const PrimitiveGroups& groups) const;
+};
+
+// Index given as the previous one at the start of a primitive
+static const u32 NO_INDEX = 0xFFFFFFFF;
+
+// Joins triangle strips with degenerate triangles whenever that's cheaper than starting a new
+// primitive, keeping the winding of every triangle. Other primitives are left as they are
+void StitchStrips(PrimitiveGroups& groups, const CostModel& cost);
+
+// Makes the triangle strips and lists of groups draw every triangle with its winding in
+// triangles: a strip drawing them all reversed is reversed if that's enough, a strip turning
+// reversed is split there, a strip starting reversed repeats its first vertex to change parity,
+// and list triangles swap two vertices. Other primitives are left as they are
+void EnforceWinding(PrimitiveGroups& groups, const std::vector<u32>& triangles);
+
+// Moves the triangles of single triangles and short strips, and of every triangle list, to one
+// triangle list when that's cheaper than a primitive for each of them
+void BatchTriangles(PrimitiveGroups& groups, const CostModel& cost);
+
+#endif // _PRIMITIVES_H_
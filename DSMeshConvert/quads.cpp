@@ -0,0 +1,265 @@
+#include "quads.h"
+#include "stripping.h"
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+struct Vec3
+{
+	float x, y, z;
+};
+
+Vec3 GetPosition(const float* positions, u32 index)
+{
+	Vec3 v = { positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2] };
+	return v;
+}
+
+Vec3 Sub(const Vec3& a, const Vec3& b)
+{
+	Vec3 v = { a.x - b.x, a.y - b.y, a.z - b.z };
+	return v;
+}
+
+Vec3 Cross(const Vec3& a, const Vec3& b)
+{
+	Vec3 v = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	return v;
+}
+
+float Dot(const Vec3& a, const Vec3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Vertices in order around the quad, with the winding of its triangles
+struct Quad
+{
+	u32 v[4];
+};
+
+// Quad made of triangle (a, b, c) and the triangle (c, b, d) on the other side of its edge b-c,
+// if their normals are close enough and the quad is convex
+bool MakeQuad(const float* positions, u32 a, u32 b, u32 c, u32 d, float minCos, Quad& quad)
+{
+	Vec3 p[4] = {
+		GetPosition(positions, a),
+		GetPosition(positions, b),
+		GetPosition(positions, d),
+		GetPosition(positions, c),
+	};
+	Vec3 n1 = Cross(Sub(p[1], p[0]), Sub(p[3], p[0]));
+	Vec3 n2 = Cross(Sub(p[1], p[3]), Sub(p[2], p[3]));
+	float l1 = sqrtf(Dot(n1, n1));
+	float l2 = sqrtf(Dot(n2, n2));
+	if ( l1 == 0.0f || l2 == 0.0f || Dot(n1, n2) < minCos * l1 * l2 )
+		return false;
+
+	// every corner turns the same way as the triangles
+	for ( u32 i = 0 ; i < 4 ; i++ )
+	{
+		Vec3 turn = Cross(Sub(p[(i + 1) % 4], p[i]), Sub(p[(i + 2) % 4], p[(i + 1) % 4]));
+		if ( Dot(turn, n1) <= 0.0f || Dot(turn, n2) <= 0.0f )
+			return false;
+	}
+
+	quad.v[0] = a;
+	quad.v[1] = b;
+	quad.v[2] = d;
+	quad.v[3] = c;
+	return true;
+}
+
+// Rotates quad so that its edge a->b starts at vertex position, returns false if it doesn't have this edge
+bool RotateQuad(const Quad& quad, u32 a, u32 b, u32 position, Quad& rotated)
+{
+	for ( u32 k = 0 ; k < 4 ; k++ )
+	{
+		if ( quad.v[k] == a && quad.v[(k + 1) % 4] == b )
+		{
+			for ( u32 i = 0 ; i < 4 ; i++ )
+				rotated.v[i] = quad.v[(k + 4 - position + i) % 4];
+			return true;
+		}
+	}
+	return false;
+}
+
+typedef std::pair<u32, u32> DirectedEdge;
+
+static const u32 SHARED_EDGE = 0xFFFFFFFF;
+
+// Pairs triangles into quads, greedily from the triangles with the fewest candidate quads
+void PairTriangles(const std::vector<u32>& indices, const float* positions, float maxAngle,
+	std::vector<Quad>& quads, std::vector<u32>& triangles)
+{
+	u32 nbTriangles = indices.size() / 3;
+
+	// triangle of each directed edge, edges used twice in the same direction aren't paired
+	std::map<DirectedEdge, u32> edges;
+	for ( u32 t = 0 ; t < nbTriangles ; t++ )
+	{
+		for ( u32 j = 0 ; j < 3 ; j++ )
+		{
+			DirectedEdge e(indices[t * 3 + j], indices[t * 3 + (j + 1) % 3]);
+			std::map<DirectedEdge, u32>::iterator it = edges.find(e);
+			if ( it == edges.end() )
+				edges[e] = t;
+			else
+				it->second = SHARED_EDGE;
+		}
+	}
+
+	float minCos = cosf(maxAngle);
+	std::vector<std::vector<std::pair<u32, Quad> > > candidates(nbTriangles);
+	for ( u32 t = 0 ; t < nbTriangles ; t++ )
+	{
+		const u32* triangle = &indices[t * 3];
+		for ( u32 j = 0 ; j < 3 ; j++ )
+		{
+			u32 a = triangle[j];
+			u32 b = triangle[(j + 1) % 3];
+			u32 c = triangle[(j + 2) % 3];
+			std::map<DirectedEdge, u32>::iterator it = edges.find(DirectedEdge(c, b));
+			if ( it == edges.end() || it->second == SHARED_EDGE || it->second == t )
+				continue;
+
+			u32 other = it->second;
+			u32 d = GetThirdVertex(&indices[other * 3], b, c);
+
+			Quad quad;
+			if ( d != b && d != c && a != d && MakeQuad(positions, a, b, c, d, minCos, quad) )
+				candidates[t].push_back(std::make_pair(other, quad));
+		}
+	}
+
+	std::vector<std::pair<u32, u32> > order;
+	for ( u32 t = 0 ; t < nbTriangles ; t++ )
+		order.push_back(std::make_pair(candidates[t].size(), t));
+	std::sort(order.begin(), order.end());
+
+	std::vector<bool> paired(nbTriangles, false);
+	for ( u32 i = 0 ; i < nbTriangles ; i++ )
+	{
+		u32 t = order[i].second;
+		if ( paired[t] )
+			continue;
+
+		u32 best = SHARED_EDGE;
+		for ( u32 j = 0 ; j < candidates[t].size() ; j++ )
+		{
+			u32 other = candidates[t][j].first;
+			if ( ! paired[other] && (best == SHARED_EDGE || candidates[other].size() < candidates[candidates[t][best].first].size()) )
+				best = j;
+		}
+		if ( best == SHARED_EDGE )
+			continue;
+
+		paired[t] = true;
+		paired[candidates[t][best].first] = true;
+		quads.push_back(candidates[t][best].second);
+	}
+
+	for ( u32 t = 0 ; t < nbTriangles ; t++ )
+	{
+		if ( ! paired[t] )
+			triangles.insert(triangles.end(), &indices[t * 3], &indices[t * 3] + 3);
+	}
+}
+
+void BuildQuads(const std::vector<u32>& indices, const float* positions, float maxAngle,
+	const CostModel& cost, PrimitiveGroups& groups, std::vector<u32>& triangles)
+{
+	std::vector<Quad> quads;
+	PairTriangles(indices, positions, maxAngle, quads, triangles);
+
+	// quad of each directed edge
+	std::map<DirectedEdge, u32> edges;
+	for ( u32 q = 0 ; q < quads.size() ; q++ )
+	{
+		for ( u32 k = 0 ; k < 4 ; k++ )
+			edges[DirectedEdge(quads[q].v[k], quads[q].v[(k + 1) % 4])] = q;
+	}
+
+	// A quad strip enters quad (p0, p1, p3, p2) through p0->p1 and leaves it through p3->p2,
+	// the next quad sharing this edge the other way around. From each quad not used yet, the
+	// strip goes back as far as it can then forward, along the direction making it longest
+	std::vector<bool> used(quads.size(), false);
+	std::vector<u32> visits(quads.size(), 0);
+	u32 visit = 0;
+	std::vector<u32> list;
+	std::vector<u32> strip, bestStrip;
+	std::vector<u32> stripQuads, bestStripQuads;
+	for ( u32 q = 0 ; q < quads.size() ; q++ )
+	{
+		if ( used[q] )
+			continue;
+
+		// q alone unless a walk comes back to it: on non-manifold meshes, a directed edge is in
+		// several quads and the map only keeps one of them, so the walks can leave q behind
+		bestStrip.clear();
+		bestStripQuads.assign(1, q);
+		for ( u32 r = 0 ; r < 2 ; r++ )
+		{
+			Quad current;
+			RotateQuad(quads[q], quads[q].v[r], quads[q].v[r + 1], 0, current);
+			u32 first = q;
+			visits[q] = ++visit;
+			for ( ;; )
+			{
+				std::map<DirectedEdge, u32>::iterator it = edges.find(DirectedEdge(current.v[1], current.v[0]));
+				Quad previous;
+				if ( it == edges.end() || used[it->second] || visits[it->second] == visit
+					|| ! RotateQuad(quads[it->second], current.v[1], current.v[0], 2, previous) )
+					break;
+				first = it->second;
+				visits[first] = visit;
+				current = previous;
+			}
+
+			strip.clear();
+			strip.push_back(current.v[0]);
+			strip.push_back(current.v[1]);
+			strip.push_back(current.v[3]);
+			strip.push_back(current.v[2]);
+			stripQuads.assign(1, first);
+			visits[first] = ++visit;
+			for ( ;; )
+			{
+				std::map<DirectedEdge, u32>::iterator it = edges.find(DirectedEdge(current.v[3], current.v[2]));
+				Quad next;
+				if ( it == edges.end() || used[it->second] || visits[it->second] == visit
+					|| ! RotateQuad(quads[it->second], current.v[3], current.v[2], 0, next) )
+					break;
+				visits[it->second] = visit;
+				stripQuads.push_back(it->second);
+				strip.push_back(next.v[3]);
+				strip.push_back(next.v[2]);
+				current = next;
+			}
+
+			if ( stripQuads.size() > bestStripQuads.size() && std::find(stripQuads.begin(), stripQuads.end(), q) != stripQuads.end() )
+			{
+				bestStrip.swap(strip);
+				bestStripQuads.swap(stripQuads);
+			}
+		}
+
+		// single quads, and quad strips costing more than their quads, go to one quad list
+		u32 listSize = list.size();
+		for ( u32 i = 0 ; i < bestStripQuads.size() ; i++ )
+		{
+			used[bestStripQuads[i]] = true;
+			list.insert(list.end(), quads[bestStripQuads[i]].v, quads[bestStripQuads[i]].v + 4);
+		}
+		u32 listCost = cost.GetCost(NO_INDEX, &list[listSize], list.size() - listSize);
+		if ( bestStripQuads.size() > 1 && cost.beginCost + cost.GetCost(NO_INDEX, &bestStrip[0], bestStrip.size()) <= listCost )
+		{
+			list.resize(listSize);
+			groups.Add(PRIM_QUAD_STRIP, &bestStrip[0], bestStrip.size());
+		}
+	}
+
+	if ( list.size() > 0 )
+		groups.Add(PRIM_QUADS, &list[0], list.size());
+}
@@ -0,0 +1,14 @@
+#ifndef _QUADS_H_
+#define _QUADS_H_
+
+#include <vector>
+#include "types.h"
+#include "primitives.h"
+
+// Pairs triangles sharing an edge into convex quads when their normals are at most maxAngle
+// radians apart, and links the quads into quad strips. positions holds x, y, z for each vertex.
+// Appends the quad primitives to groups, and the triangles left unpaired to triangles
+void BuildQuads(const std::vector<u32>& indices, const float* positions, float maxAngle,
+	const CostModel& cost, PrimitiveGroups& groups, std::vector<u32>& triangles);
+
+#endif // _QUADS_H_
@@ -0,0 +1,368 @@
+#include "simplify.h"
+#include <math.h>
+#include <map>
+#include <set>
+#include <queue>
+#include <algorithm>
+
+// Sum of the squared distances to planes, each one weighted: the symmetric matrix
+// of a x + b y + c z + d = 0 is [a b c d]^T [a b c d]
+struct Quadric
+{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight;
+
+	Quadric()
+	: a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0)
+	{
+	}
+
+	void AddPlane(double a, double b, double c, double d, double w)
+	{
+		a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+		b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+		c2 += w * c * c; cd += w * c * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	void Add(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	double Evaluate(const float* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		return x * x * a2 + 2 * x * y * ab + 2 * x * z * ac + 2 * x * ad
+			+ y * y * b2 + 2 * y * z * bc + 2 * y * bd
+			+ z * z * c2 + 2 * z * cd
+			+ d2;
+	}
+};
+
+// Moving vertex from onto vertex to. The versions tell whether the vertices changed since
+// the cost was computed. Ordered for the cheapest collapse to come first out of a priority queue
+struct Collapse
+{
+	double cost;
+	u32 from, to;
+	u32 fromVersion, toVersion;
+
+	bool operator<(const Collapse& c) const { return cost > c.cost; }
+};
+
+// Orders positions, to find the vertices sharing one
+struct PositionLess
+{
+	const float* positions;
+
+	bool operator()(u32 a, u32 b) const
+	{
+		const float* p = &positions[a * 3];
+		const float* q = &positions[b * 3];
+		if ( p[0] != q[0] ) return p[0] < q[0];
+		if ( p[1] != q[1] ) return p[1] < q[1];
+		return p[2] < q[2];
+	}
+};
+
+static const u32 DEAD_TRIANGLE = 0xFFFFFFFF;
+
+struct Simplifier
+{
+	const float* positions;
+	std::vector<u32> indices;						// DEAD_TRIANGLE for the 3 indices of a collapsed triangle
+	std::vector<std::vector<u32> > vertexTriangles;	// may still hold dead triangles
+	std::vector<Quadric> quadrics;
+	std::vector<bool> locked;
+	std::vector<u32> versions;
+	std::priority_queue<Collapse> collapses;
+	u32 nbTriangles;								// alive
+	double maxError;
+
+	Simplifier(const std::vector<u32>& triangles, const float* vertices, u32 nbVertices)
+	: positions(vertices)
+	, vertexTriangles(nbVertices)
+	, quadrics(nbVertices)
+	, locked(nbVertices, false)
+	, versions(nbVertices, 0)
+	, nbTriangles(0)
+	, maxError(0.0)
+	{
+		// degenerate triangles draw nothing, they're left out of every level
+		for ( u32 i = 0 ; i + 2 < triangles.size() ; i += 3 )
+		{
+			u32 a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+			if ( a == b || b == c || c == a )
+				continue;
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+		nbTriangles = indices.size() / 3;
+
+		LockVertices(nbVertices);
+
+		for ( u32 t = 0 ; t < nbTriangles ; t++ )
+		{
+			const u32* triangle = &indices[t * 3];
+			for ( u32 j = 0 ; j < 3 ; j++ )
+				vertexTriangles[triangle[j]].push_back(t);
+
+			double n[3];
+			double area = GetNormal(triangle[0], triangle[1], triangle[2], n);
+			if ( area <= 0.0 )
+				continue;
+			const float* p = &positions[triangle[0] * 3];
+			double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+			for ( u32 j = 0 ; j < 3 ; j++ )
+				quadrics[triangle[j]].AddPlane(n[0], n[1], n[2], d, area);
+		}
+
+		for ( u32 t = 0 ; t < nbTriangles ; t++ )
+		{
+			for ( u32 j = 0 ; j < 3 ; j++ )
+			{
+				AddCollapse(indices[t * 3 + j], indices[t * 3 + (j + 1) % 3]);
+				AddCollapse(indices[t * 3 + (j + 1) % 3], indices[t * 3 + j]);
+			}
+		}
+	}
+
+	// Locks the vertices sharing their position, and the ones on an edge which doesn't have
+	// exactly two triangles once the vertices sharing a position are taken as one
+	void LockVertices(u32 nbVertices)
+	{
+		PositionLess less = { positions };
+		std::map<u32, u32, PositionLess> firstVertices(less);
+		std::vector<u32> positionIds(nbVertices);
+		std::vector<u32> used(nbVertices, 0);
+		for ( u32 i = 0 ; i < indices.size() ; i++ )
+			used[indices[i]] = 1;
+
+		std::vector<u32> nbShared;
+		for ( u32 v = 0 ; v < nbVertices ; v++ )
+		{
+			if ( ! used[v] )
+				continue;
+			std::map<u32, u32, PositionLess>::iterator it = firstVertices.find(v);
+			if ( it == firstVertices.end() )
+			{
+				it = firstVertices.insert(std::make_pair(v, (u32)nbShared.size())).first;
+				nbShared.push_back(0);
+			}
+			positionIds[v] = it->second;
+			nbShared[it->second]++;
+		}
+
+		std::vector<bool> lockedPositions(nbShared.size(), false);
+		for ( u32 i = 0 ; i < nbShared.size() ; i++ )
+			lockedPositions[i] = nbShared[i] > 1;
+
+		std::map<std::pair<u32, u32>, u32> edges;
+		for ( u32 t = 0 ; t < nbTriangles ; t++ )
+		{
+			for ( u32 j = 0 ; j < 3 ; j++ )
+			{
+				u32 a = positionIds[indices[t * 3 + j]];
+				u32 b = positionIds[indices[t * 3 + (j + 1) % 3]];
+				edges[a < b ? std::make_pair(a, b) : std::make_pair(b, a)]++;
+			}
+		}
+		std::map<std::pair<u32, u32>, u32>::iterator it;
+		for ( it = edges.begin() ; it != edges.end() ; ++it )
+		{
+			if ( it->second != 2 )
+			{
+				lockedPositions[it->first.first] = true;
+				lockedPositions[it->first.second] = true;
+			}
+		}
+
+		for ( u32 v = 0 ; v < nbVertices ; v++ )
+			locked[v] = used[v] && lockedPositions[positionIds[v]];
+	}
+
+	// Unit normal of the triangle (a, b, c), returns its area
+	double GetNormal(u32 a, u32 b, u32 c, double* n) const
+	{
+		const float* p0 = &positions[a * 3];
+		const float* p1 = &positions[b * 3];
+		const float* p2 = &positions[c * 3];
+		double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if ( length > 0.0 )
+		{
+			n[0] /= length;
+			n[1] /= length;
+			n[2] /= length;
+		}
+		return length * 0.5;
+	}
+
+	void AddCollapse(u32 from, u32 to)
+	{
+		if ( locked[from] )
+			return;
+
+		Quadric q = quadrics[from];
+		q.Add(quadrics[to]);
+		Collapse c;
+		c.cost = q.Evaluate(&positions[to * 3]);
+		if ( q.weight > 0.0 )
+			c.cost /= q.weight;
+		c.from = from;
+		c.to = to;
+		c.fromVersion = versions[from];
+		c.toVersion = versions[to];
+		collapses.push(c);
+	}
+
+	bool HasVertex(u32 t, u32 v) const
+	{
+		return indices[t * 3] == v || indices[t * 3 + 1] == v || indices[t * 3 + 2] == v;
+	}
+
+	void GetNeighbours(u32 v, std::set<u32>& neighbours) const
+	{
+		neighbours.clear();
+		for ( u32 i = 0 ; i < vertexTriangles[v].size() ; i++ )
+		{
+			u32 t = vertexTriangles[v][i];
+			if ( indices[t * 3] == DEAD_TRIANGLE )
+				continue;
+			for ( u32 j = 0 ; j < 3 ; j++ )
+			{
+				if ( indices[t * 3 + j] != v )
+					neighbours.insert(indices[t * 3 + j]);
+			}
+		}
+	}
+
+	// A collapse keeps the surface a manifold if the only neighbours from and to share are
+	// the third vertices of the triangles of their edge, and it mustn't flip a triangle over
+	bool IsValid(u32 from, u32 to) const
+	{
+		std::set<u32> fromNeighbours, toNeighbours;
+		GetNeighbours(from, fromNeighbours);
+		GetNeighbours(to, toNeighbours);
+		if ( fromNeighbours.count(to) == 0 )
+			return false;
+
+		u32 nbShared = 0;
+		for ( u32 i = 0 ; i < vertexTriangles[from].size() ; i++ )
+		{
+			u32 t = vertexTriangles[from][i];
+			if ( indices[t * 3] != DEAD_TRIANGLE && HasVertex(t, to) )
+				nbShared++;
+		}
+		u32 nbCommon = 0;
+		std::set<u32>::const_iterator it;
+		for ( it = fromNeighbours.begin() ; it != fromNeighbours.end() ; ++it )
+			nbCommon += toNeighbours.count(*it);
+		if ( nbCommon != nbShared )
+			return false;
+
+		for ( u32 i = 0 ; i < vertexTriangles[from].size() ; i++ )
+		{
+			u32 t = vertexTriangles[from][i];
+			if ( indices[t * 3] == DEAD_TRIANGLE || HasVertex(t, to) )
+				continue;
+
+			u32 moved[3];
+			for ( u32 j = 0 ; j < 3 ; j++ )
+				moved[j] = indices[t * 3 + j] == from ? to : indices[t * 3 + j];
+			double before[3], after[3];
+			GetNormal(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], before);
+			if ( GetNormal(moved[0], moved[1], moved[2], after) <= 0.0
+				|| before[0] * after[0] + before[1] * after[1] + before[2] * after[2] < 0.2 ) // turned by more than 78 degrees
+				return false;
+		}
+		return true;
+	}
+
+	void Apply(const Collapse& c)
+	{
+		u32 from = c.from;
+		u32 to = c.to;
+		for ( u32 i = 0 ; i < vertexTriangles[from].size() ; i++ )
+		{
+			u32 t = vertexTriangles[from][i];
+			if ( indices[t * 3] == DEAD_TRIANGLE )
+				continue;
+
+			if ( HasVertex(t, to) )
+			{
+				indices[t * 3] = indices[t * 3 + 1] = indices[t * 3 + 2] = DEAD_TRIANGLE;
+				nbTriangles--;
+				continue;
+			}
+			for ( u32 j = 0 ; j < 3 ; j++ )
+			{
+				if ( indices[t * 3 + j] == from )
+					indices[t * 3 + j] = to;
+			}
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from].clear();
+		quadrics[to].Add(quadrics[from]);
+		versions[from]++;
+		versions[to]++;
+		maxError = std::max(maxError, c.cost);
+
+		std::set<u32> neighbours;
+		GetNeighbours(to, neighbours);
+		std::set<u32>::const_iterator it;
+		for ( it = neighbours.begin() ; it != neighbours.end() ; ++it )
+		{
+			AddCollapse(to, *it);
+			AddCollapse(*it, to);
+		}
+	}
+
+	// Collapses edges until at most target triangles are left, or no collapse is valid
+	void Simplify(u32 target)
+	{
+		while ( nbTriangles > target && ! collapses.empty() )
+		{
+			Collapse c = collapses.top();
+			collapses.pop();
+			if ( c.fromVersion != versions[c.from] || c.toVersion != versions[c.to] || ! IsValid(c.from, c.to) )
+				continue;
+			Apply(c);
+		}
+	}
+
+	void GetLevel(LodLevel& level) const
+	{
+		level.indices.clear();
+		for ( u32 i = 0 ; i < indices.size() ; i += 3 )
+		{
+			if ( indices[i] != DEAD_TRIANGLE )
+				level.indices.insert(level.indices.end(), &indices[i], &indices[i] + 3);
+		}
+		level.error = float(sqrt(std::max(maxError, 0.0)));
+	}
+};
+
+void BuildLodChain(const std::vector<u32>& indices, const float* positions, u32 nbVertices,
+	const std::vector<float>& ratios, std::vector<LodLevel>& levels)
+{
+	Simplifier simplifier(indices, positions, nbVertices);
+	u32 nbTriangles = indices.size() / 3;
+	for ( u32 i = 0 ; i < ratios.size() ; i++ )
+	{
+		simplifier.Simplify(u32(nbTriangles * ratios[i]));
+		levels.push_back(LodLevel());
+		simplifier.GetLevel(levels.back());
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef _SIMPLIFY_H_
+#define _SIMPLIFY_H_
+
+#include <vector>
+#include "types.h"
+
+// A level of detail: the triangles left, and how far they are from the full mesh
+struct LodLevel
+{
+	std::vector<u32> indices;
+	float error;	// area-weighted RMS distance to the planes of the triangles collapsed, in model units
+};
+
+// Surface Simplification Using Quadric Error Metrics
+// Michael Garland and Paul S. Heckbert, SIGGRAPH 97
+//
+// Collapses the edges of indices from the cheapest one on, and appends a level to levels every
+// time the triangles left go down to ratios[i] of the ones at the start, ratios going down too.
+// A vertex only ever moves onto a neighbour, so that the levels keep using the vertices and
+// attributes of the full mesh. Vertices on a boundary or a non-manifold edge, and vertices
+// sharing their position with others (seams of the texture coordinates, normals or colors)
+// never move. positions holds x, y, z for each vertex
+void BuildLodChain(const std::vector<u32>& indices, const float* positions, u32 nbVertices,
+	const std::vector<float>& ratios, std::vector<LodLevel>& levels);
+
+#endif // _SIMPLIFY_H_
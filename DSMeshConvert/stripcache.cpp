@@ -0,0 +1,117 @@
+#include "stripcache.h"
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+TopologyHash::TopologyHash()
+: hash(14695981039346656037ULL)
+{
+}
+
+void TopologyHash::Add(const void* data, u32 size)
+{
+	const u8* bytes = (const u8*)data;
+	for ( u32 i = 0 ; i < size ; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+void TopologyHash::Add(const char* text)
+{
+	// the terminating zero keeps "ab" + "c" apart from "a" + "bc"
+	Add(text, strlen(text) + 1);
+}
+
+// A cache file: this header, then the types, the lengths and the indices of the primitives
+struct CacheHeader
+{
+	u32 magic;
+	u32 version;
+	u64 hash;
+	u32 nbPrimitives;
+	u32 nbIndices;
+};
+
+static const u32 CACHE_MAGIC = 0x43535344; // "DSSC"
+static const u32 CACHE_VERSION = 1;
+
+std::string GetCachePath(const char* directory, u64 hash)
+{
+	char name[32];
+	sprintf(name, "%08x%08x.strips", u32(hash >> 32), u32(hash));
+	return std::string(directory) + "/" + name;
+}
+
+bool LoadStrips(const char* directory, u64 hash, PrimitiveGroups& strips)
+{
+	FILE* f = fopen(GetCachePath(directory, hash).c_str(), "rb");
+	if ( f == 0 )
+		return false;
+
+	bool ok = fseek(f, 0, SEEK_END) == 0;
+	long size = ok ? ftell(f) : -1;
+	ok = size >= 0 && fseek(f, 0, SEEK_SET) == 0;
+
+	// the counts are checked against the file size before anything is allocated for them
+	CacheHeader header;
+	ok = ok && fread(&header, sizeof(header), 1, f) == 1
+		&& header.magic == CACHE_MAGIC && header.version == CACHE_VERSION && header.hash == hash
+		&& u64(size) == sizeof(header) + 2 * sizeof(u32) * u64(header.nbPrimitives) + sizeof(u32) * u64(header.nbIndices);
+	if ( ok )
+	{
+		strips.types.resize(header.nbPrimitives);
+		strips.lengths.resize(header.nbPrimitives);
+		strips.indices.resize(header.nbIndices);
+		ok = (header.nbPrimitives == 0 || (fread(&strips.types[0], sizeof(u32), header.nbPrimitives, f) == header.nbPrimitives
+				&& fread(&strips.lengths[0], sizeof(u32), header.nbPrimitives, f) == header.nbPrimitives))
+			&& (header.nbIndices == 0 || fread(&strips.indices[0], sizeof(u32), header.nbIndices, f) == header.nbIndices);
+	}
+	fclose(f);
+
+	// a truncated or inconsistent file is a miss
+	u32 nbIndices = 0;
+	for ( u32 i = 0 ; ok && i < strips.lengths.size() ; i++ )
+		nbIndices += strips.lengths[i];
+	if ( ! ok || nbIndices != strips.indices.size() )
+	{
+		strips.Clear();
+		return false;
+	}
+	return true;
+}
+
+bool SaveStrips(const char* directory, u64 hash, const PrimitiveGroups& strips)
+{
+	// written under a name of its own then renamed, so that a reader never sees a partial file,
+	// and converters caching the same mesh at once don't write into each other's
+	std::string path = GetCachePath(directory, hash);
+	char suffix[32];
+	sprintf(suffix, ".%lu.%lu.tmp", (unsigned long)GetCurrentProcessId(), (unsigned long)GetCurrentThreadId());
+	std::string tempPath = path + suffix;
+	FILE* f = fopen(tempPath.c_str(), "wb");
+	if ( f == 0 )
+		return false;
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.hash = hash;
+	header.nbPrimitives = strips.GetNbPrimitives();
+	header.nbIndices = strips.indices.size();
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	if ( ok && header.nbPrimitives > 0 )
+	{
+		ok = fwrite(&strips.types[0], sizeof(u32), header.nbPrimitives, f) == header.nbPrimitives
+			&& fwrite(&strips.lengths[0], sizeof(u32), header.nbPrimitives, f) == header.nbPrimitives;
+	}
+	if ( ok && header.nbIndices > 0 )
+		ok = fwrite(&strips.indices[0], sizeof(u32), header.nbIndices, f) == header.nbIndices;
+	ok = fclose(f) == 0 && ok
+		&& MoveFileEx(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+	if ( ! ok )
+		remove(tempPath.c_str());
+	return ok;
+}
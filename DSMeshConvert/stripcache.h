@@ -0,0 +1,26 @@
+#ifndef _STRIPCACHE_H_
+#define _STRIPCACHE_H_
+
+#include "types.h"
+#include "stripper.h"
+
+// 64-bit FNV-1a hash of what the strips of a mesh depend on
+struct TopologyHash
+{
+	u64 hash;
+
+	TopologyHash();
+
+	void Add(const void* data, u32 size);
+	void Add(u32 value) { Add(&value, sizeof(value)); }
+	void Add(float value) { Add(&value, sizeof(value)); }
+	void Add(const char* text);
+};
+
+// Reads the strips cached for hash in directory, returns false if there are none
+bool LoadStrips(const char* directory, u64 hash, PrimitiveGroups& strips);
+
+// Caches strips for hash in directory, which must exist
+bool SaveStrips(const char* directory, u64 hash, const PrimitiveGroups& strips);
+
+#endif // _STRIPCACHE_H_
@@ -0,0 +1,214 @@
+#include "stripper.h"
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+
+#include "NvTriStrip.h"
+#include "cets-pterdiman/Striper.h"
+#include "ac/tc.h"
+#include "stripping.h"
+#include "matching.h"
+
+void PrimitiveGroups::Clear()
+{
+	types.clear();
+	lengths.clear();
+	indices.clear();
+}
+
+void PrimitiveGroups::Add(u32 type, const u32* first, u32 count)
+{
+	types.push_back(type);
+	lengths.push_back(count);
+	indices.insert(indices.end(), first, first + count);
+}
+
+void PrimitiveGroups::Add(const PrimitiveGroups& groups)
+{
+	types.insert(types.end(), groups.types.begin(), groups.types.end());
+	lengths.insert(lengths.end(), groups.lengths.begin(), groups.lengths.end());
+	indices.insert(indices.end(), groups.indices.begin(), groups.indices.end());
+}
+
+// http://plunk.org/~grantham/public/actc/
+class ActcStripper : public Stripper
+{
+public:
+	const char* GetName() const { return "actc"; }
+
+	bool Strip(const std::vector<u32>& triangles, PrimitiveGroups& groups)
+	{
+		// ACTC reads out of its vertex bins when there's no vertex at all
+		if ( triangles.empty() )
+			return true;
+
+		ACTCData* tc = actcNew();
+		if ( tc == 0 )
+			return false;
+
+		actcParami(tc, ACTC_OUT_MIN_FAN_VERTS, INT_MAX);
+		// ACTC makes longer strips honoring winding than going through reversed edges, whether
+		// the winding has to be kept or not
+		actcParami(tc, ACTC_OUT_HONOR_WINDING, ACTC_TRUE);
+		actcBeginInput(tc);
+		for ( u32 i = 0 ; i < triangles.size() ; i += 3 )
+			actcAddTriangle(tc, triangles[i], triangles[i + 1], triangles[i + 2]);
+		actcEndInput(tc);
+
+		actcBeginOutput(tc);
+		int prim;
+		u32 v1, v2, v3;
+		while ( (prim = actcStartNextPrim(tc, &v1, &v2)) >= 0 )
+		{
+			groups.types.push_back(PRIM_TRIANGLE_STRIP);
+			groups.indices.push_back(v1);
+			groups.indices.push_back(v2);
+			u32 len = 2;
+			while ( actcGetNextVert(tc, &v3) != ACTC_PRIM_COMPLETE )
+			{
+				len++;
+				groups.indices.push_back(v3);
+			}
+			groups.lengths.push_back(len);
+		}
+		actcEndOutput(tc);
+		actcDelete(tc);
+
+		return prim == ACTC_DATABASE_EMPTY;
+	}
+};
+
+// http://developer.nvidia.com/object/nvtristrip_library.html
+class NvTriStripStripper : public Stripper
+{
+public:
+	NvTriStripStripper()
+	{
+		mContext.bStitchStrips = false;
+		mContext.cacheSize = CACHESIZE_NONE; // ds has no cache, give me longest strips possible
+	}
+
+	const char* GetName() const { return "nvtristrip"; }
+
+	bool Strip(const std::vector<u32>& triangles, PrimitiveGroups& groups)
+	{
+		if ( triangles.empty() )
+			return true;
+
+		u32 nbStrips = 0;
+		PrimitiveGroup32* strips = 0;
+		if ( ! GenerateStrips(mContext, &triangles[0], triangles.size(), &strips, &nbStrips) )
+			return false;
+
+		bool ok = true;
+		for ( u32 i = 0 ; i < nbStrips ; i++ )
+		{
+			if ( strips[i].type == PT_STRIP )
+			{
+				groups.Add(PRIM_TRIANGLE_STRIP, strips[i].indices, strips[i].numIndices);
+			}
+			else if ( strips[i].type == PT_LIST )
+			{
+				groups.Add(PRIM_TRIANGLES, strips[i].indices, strips[i].numIndices);
+			}
+			else // if ( strips[i].type == PT_FAN )
+			{
+				fprintf(stderr, "NvTriStrip generated a fan list\n");
+				ok = false;
+				break;
+			}
+		}
+
+		delete[] strips;
+		return ok;
+	}
+
+private:
+	StripContext mContext;
+};
+
+// http://www.codercorner.com/Strips.htm
+class PterdimanStripper : public Stripper
+{
+public:
+	const char* GetName() const { return "striper"; }
+
+	bool Strip(const std::vector<u32>& triangles, PrimitiveGroups& groups)
+	{
+		if ( triangles.empty() )
+			return true;
+
+		// the striper doesn't write to the faces
+		STRIPERCREATE sc;
+		sc.DFaces			= const_cast<u32*>(&triangles[0]);
+		sc.NbFaces			= triangles.size() / 3;
+		sc.AskForWords		= false;
+		sc.ConnectAllStrips	= false;
+		sc.OneSided			= mHonorWinding;
+		sc.SGIAlgorithm		= false;
+
+		Striper striper;
+		if ( ! striper.Init(sc) )
+			return false;
+
+		STRIPERRESULT sr;
+		if ( ! striper.Compute(sr) )
+			return false;
+
+		const u32* runs = (const u32*)sr.StripRuns;
+		for ( u32 i = 0 ; i < sr.NbStrips ; i++ )
+		{
+			groups.Add(PRIM_TRIANGLE_STRIP, runs, sr.StripLengths[i]);
+			runs += sr.StripLengths[i];
+		}
+
+		return true;
+	}
+};
+
+// Multi-Path Algorithm for Triangle Strips, see stripping.cpp
+class MultiPathStripper : public Stripper
+{
+public:
+	const char* GetName() const { return "multipath"; }
+
+	bool Strip(const std::vector<u32>& triangles, PrimitiveGroups& groups)
+	{
+		BuildTriangleStrips(triangles, groups, mHonorWinding);
+		return true;
+	}
+};
+
+// Maximum matching of the dual graph extended into paths, see matching.cpp
+class MatchingStripper : public Stripper
+{
+public:
+	const char* GetName() const { return "matching"; }
+
+	bool Strip(const std::vector<u32>& triangles, PrimitiveGroups& groups)
+	{
+		u32 nbPaths, minPaths;
+		BuildMatchingStrips(triangles, groups, mHonorWinding, mNbThreads, nbPaths, minPaths);
+		printf("Matching: %d paths, at least %d needed (%.1f%% more)\n", nbPaths, minPaths,
+			minPaths > 0 ? 100.0f * (nbPaths - minPaths) / minPaths : 0.0f);
+		return true;
+	}
+};
+
+const char* const stripperNames[] = { "actc", "nvtristrip", "striper", "multipath", "matching" };
+const u32 nbStrippers = sizeof(stripperNames) / sizeof(stripperNames[0]);
+
+Stripper* CreateStripper(const char* name)
+{
+	if ( strcmp(name, "actc") == 0 )
+		return new ActcStripper;
+	if ( strcmp(name, "nvtristrip") == 0 )
+		return new NvTriStripStripper;
+	if ( strcmp(name, "striper") == 0 )
+		return new PterdimanStripper;
+	if ( strcmp(name, "multipath") == 0 )
+		return new MultiPathStripper;
+	if ( strcmp(name, "matching") == 0 )
+		return new MatchingStripper;
+	return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef _STRIPPER_H_
+#define _STRIPPER_H_
+
+#include <vector>
+#include "types.h"
+
+// Primitive types, as given to the BEGIN_VTXS command
+enum PrimitiveType
+{
+	PRIM_TRIANGLES = 0,
+	PRIM_QUADS = 1,
+	PRIM_TRIANGLE_STRIP = 2,
+	PRIM_QUAD_STRIP = 3,
+};
+
+// Primitives in one flat layout: primitive i is of types[i] and uses lengths[i]
+// indices, right after the ones of primitive i - 1
+struct PrimitiveGroups
+{
+	std::vector<u32> types;
+	std::vector<u32> lengths;
+	std::vector<u32> indices;
+
+	u32 GetNbPrimitives() const { return types.size(); }
+	void Clear();
+	void Add(u32 type, const u32* first, u32 count);
+	void Add(const PrimitiveGroups& groups);
+};
+
+// Turns a triangle list into primitives
+class Stripper
+{
+public:
+	Stripper() : mHonorWinding(false), mNbThreads(0) {}
+	virtual ~Stripper() {}
+
+	virtual const char* GetName() const = 0;
+
+	// Whether every triangle has to be drawn with its winding, so that back faces can be culled
+	void SetHonorWinding(bool honor) { mHonorWinding = honor; }
+
+	// Threads a call to Strip() may use, 0 for one per processor
+	void SetNbThreads(u32 nbThreads) { mNbThreads = nbThreads; }
+
+	// Appends the primitives of triangles (3 indices per triangle) to groups,
+	// returns false if they couldn't be generated
+	virtual bool Strip(const std::vector<u32>& triangles, PrimitiveGroups& groups) = 0;
+
+protected:
+	bool mHonorWinding;
+	u32 mNbThreads;
+};
+
+// Names of the available strippers, the first one is the default
+extern const char* const stripperNames[];
+extern const u32 nbStrippers;
+
+// Returns a new stripper, or 0 if name is unknown
+Stripper* CreateStripper(const char* name);
+
+#endif // _STRIPPER_H_
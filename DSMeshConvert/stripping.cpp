@@ -1,216 +1,608 @@
 #include "stripping.h"
+#include <algorithm>
 #include <map>
 #include <set>
 #define AI_WONT_RETURN
 #include <aiAssert.h>
 
-u32 GetNodeFromSet(std::set<u32> (&unconnected)[4], std::set<u32> (&connected)[2], u32& settype, u32& setid)
+typedef std::pair<u32, u32> Edge;
+
+Edge MakeEdge(u32 a, u32 b)
+{
+	return a < b ? Edge(a, b) : Edge(b, a);
+}
+
+void BuildDualGraph(const std::vector<u32>& indices, std::vector<std::set<u32> >& graph)
 {
-	u32 node;
+	u32 nbTriangles = indices.size() / 3;
 
-	if ( unconnected[0].size() > 0 )
+	// build edge map
+	std::map<Edge, std::vector<u32> > connections;
+	for ( u32 i = 0, triangle = 0 ; triangle < nbTriangles ; i += 3, triangle++ )
 	{
-		node = *unconnected[0].begin();
-		unconnected[0].erase(node);
-		settype = 0;
-		setid = 0;
+		for ( u32 j = 0 ; j < 3 ; j++ )
+		{
+			static u32 a[] = { 0, 0, 1 };
+			static u32 b[] = { 1, 2, 2 };
+			if ( indices[i + a[j]] != indices[i + b[j]] )
+			{
+				connections[MakeEdge(indices[i + a[j]], indices[i + b[j]])].push_back(triangle);
+			}
+		}
 	}
-	else if ( unconnected[1].size() > 0 )
+
+	// build dual graph
+	graph.assign(nbTriangles, std::set<u32>());
+	std::map<Edge, std::vector<u32> >::iterator it;
+	for ( it = connections.begin() ; it != connections.end() ; ++it )
 	{
-		node = *unconnected[1].begin();
-		unconnected[1].erase(node);
-		settype = 0;
-		setid = 1;
+		std::vector<u32>& triangles = it->second;
+		for ( u32 i = 0 ; i < triangles.size() ; i++ )
+		{
+			graph[triangles[i]].insert(triangles.begin(), triangles.end());
+			graph[triangles[i]].erase(triangles[i]);
+		}
 	}
-	else if ( connected[0].size() > 0 )
+}
+
+bool HasVertex(const u32* triangle, u32 v)
+{
+	return triangle[0] == v || triangle[1] == v || triangle[2] == v;
+}
+
+// Paths covering the dual graph, built by connecting its nodes two by two
+struct PathCover
+{
+	struct Node
 	{
-		node = *connected[1].begin();
-		connected[1].erase(node);
-		settype = 1;
-		setid = 0;
-	}
-	else if ( unconnected[2].size() > 0 )
+		std::set<u32> neighbours;	// graph edges neither used nor dropped yet
+		u32 links[2];				// neighbours in the path
+		u32 nbLinks;
+		u32 end;					// other end of the path, for the ends of a path
+	};
+
+	std::vector<Node> nodes;
+	std::set<std::pair<u32, u32> > queue;	// (rank, node) of the nodes left to connect
+
+	// Nodes with fewer neighbours left go first, and nodes which already are the end
+	// of a path go before the single nodes with one more neighbour
+	u32 Rank(u32 node) const
 	{
-		node = *unconnected[2].begin();
-		unconnected[2].erase(node);
-		settype = 0;
-		setid = 2;
+		return 2 * nodes[node].neighbours.size() - (nodes[node].nbLinks == 0 ? 1 : 0);
 	}
-	else if ( connected[1].size() > 0 )
+
+	void Queue(u32 node)
 	{
-		node = *connected[2].begin();
-		connected[0].erase(node);
-		settype = 1;
-		setid = 1;
+		if ( nodes[node].nbLinks < 2 && nodes[node].neighbours.size() > 0 )
+			queue.insert(std::make_pair(Rank(node), node));
 	}
-	else 
+
+	void Unqueue(u32 node)
 	{
-		node = *unconnected[3].begin();
-		unconnected[3].erase(node);
-		settype = 0;
-		setid = 3;
+		if ( nodes[node].nbLinks < 2 && nodes[node].neighbours.size() > 0 )
+			queue.erase(std::make_pair(Rank(node), node));
 	}
 
-	return node;
-}
-
-void Find(u32 node, std::set<u32> (&unconnected)[4], std::set<u32> (&connected)[2], u32& settype, u32& setid)
-{
-	for ( u32 i = 0 ; i < 4 ; i++ )
+	// A node in the middle of a path can't be connected anymore
+	void DropEdgesIfFull(u32 node)
 	{
-		std::set<u32>::iterator it = unconnected[i].find(node);
-		if ( it != unconnected[i].end() )
-		{
-			settype = 0;
-			setid = i;
+		if ( nodes[node].nbLinks < 2 )
 			return;
+
+		std::set<u32>::iterator it;
+		for ( it = nodes[node].neighbours.begin() ; it != nodes[node].neighbours.end() ; ++it )
+		{
+			Unqueue(*it);
+			nodes[*it].neighbours.erase(node);
+			Queue(*it);
 		}
+		nodes[node].neighbours.clear();
 	}
 
-	for ( u32 i = 0 ; i < 2 ; i++ )
+	// Uses the edge a-b in a path, or drops it if that would close a loop
+	void Connect(u32 a, u32 b)
 	{
-		std::set<u32>::iterator it = connected[i].find(node);
-		if ( it != connected[i].end() )
+		Unqueue(a);
+		Unqueue(b);
+		nodes[a].neighbours.erase(b);
+		nodes[b].neighbours.erase(a);
+
+		if ( nodes[a].end != b )
 		{
-			settype = 1;
-			setid = i;
-			return;
+			u32 endA = nodes[a].end;
+			u32 endB = nodes[b].end;
+			nodes[endA].end = endB;
+			nodes[endB].end = endA;
+			nodes[a].links[nodes[a].nbLinks++] = b;
+			nodes[b].links[nodes[b].nbLinks++] = a;
+			DropEdgesIfFull(a);
+			DropEdgesIfFull(b);
 		}
+
+		Queue(a);
+		Queue(b);
 	}
-}
 
-void MoveNodeToSet(u32 node, u32 nodeSetID, u32 nodeSetType, std::set<u32> (&connected)[2], std::set<u32> &fullyConnected)
-{
-	if ( nodeSetType == 0 && nodeSetID > 0 )
+	void Build(const std::vector<std::set<u32> >& graph)
 	{
-		if ( nodeSetID == 1 )
+		nodes.resize(graph.size());
+		for ( u32 i = 0 ; i < graph.size() ; i++ )
 		{
-			connected[0].insert(node);
+			nodes[i].neighbours = graph[i];
+			nodes[i].nbLinks = 0;
+			nodes[i].end = i;
+			Queue(i);
 		}
-		else
+
+		while ( queue.size() > 0 )
 		{
-			connected[nodeSetID - 2].insert(node);
+			u32 node = queue.begin()->second;
+
+			// connect to the neighbour which would be the hardest to connect later
+			u32 best = *nodes[node].neighbours.begin();
+			std::set<u32>::iterator it;
+			for ( it = nodes[node].neighbours.begin() ; it != nodes[node].neighbours.end() ; ++it )
+			{
+				if ( Rank(*it) < Rank(best) )
+					best = *it;
+			}
+
+			Connect(node, best);
+		}
+	}
+
+	// The path starting at node, which must be the end of a path
+	void GetPath(u32 node, std::vector<u32>& path) const
+	{
+		path.clear();
+		u32 previous = node;
+		for ( ;; )
+		{
+			path.push_back(node);
+			const Node& n = nodes[node];
+			u32 next;
+			if ( n.nbLinks > 0 && n.links[0] != previous )
+				next = n.links[0];
+			else if ( n.nbLinks > 1 && n.links[1] != previous )
+				next = n.links[1];
+			else
+				break;
+			previous = node;
+			node = next;
 		}
 	}
-	else
+};
+
+bool IsSameWinding(const u32* triangle, u32 a, u32 b, u32 c)
+{
+	for ( u32 i = 0 ; i < 3 ; i++ )
 	{
-		fullyConnected.insert(node);
+		if ( triangle[i] == a )
+			return triangle[(i + 1) % 3] == b && triangle[(i + 2) % 3] == c;
 	}
+	return false;
 }
 
-// Multi-Path Algorithm for Triangle Strips
-// Petr Vanecek, Ivana Kolingerova
-// From the draft of September 16, 2004
-std::vector<u32> BuildTriangleStrips(std::vector<u32> indices)
+// Whether the last triangle of strip, drawn reversed at odd positions, has the winding of triangle
+bool HasLastWinding(const std::vector<u32>& strip, const u32* triangle)
 {
-	u32 nbTriangles = indices.size() / 3;
+	u32 n = strip.size();
+	if ( (n - 3) % 2 == 0 )
+		return IsSameWinding(triangle, strip[n - 3], strip[n - 2], strip[n - 1]);
+	return IsSameWinding(triangle, strip[n - 2], strip[n - 3], strip[n - 1]);
+}
 
-	// build edge map
-	std::map<std::pair<u32, u32>, std::vector<u32> > connections;
-	u32 triangle = 0;
-	for ( u32 i = 0 ; i < indices.size() ; i += 3, triangle++ )
+u32 GetThirdVertex(const u32* triangle, u32 a, u32 b)
+{
+	for ( u32 i = 0 ; i < 3 ; i++ )
 	{
-		for ( u32 j = 0 ; j < 3 ; j++ )
+		if ( triangle[i] != a && triangle[i] != b )
+			return triangle[i];
+	}
+	return triangle[0];
+}
+
+// Turns a path of the dual graph into strips. A triangle sharing the last two vertices of the
+// strip adds its third one; a triangle sharing the last and third to last vertices needs the
+// strip to swap them first, which costs two degenerate triangles; and the strip starts over
+// when the path turns back to the edge it came from (non-manifold edges only). When honoring
+// winding, a strip starting with a reversed triangle repeats its first vertex, and the strip
+// starts over at a triangle it would draw reversed (where the mesh isn't consistently oriented)
+void PathToStrips(const std::vector<u32>& path, const std::vector<u32>& indices, PrimitiveGroups& strips, bool honorWinding)
+{
+	std::vector<u32> strip;
+	for ( u32 i = 0 ; i < path.size() ; i++ )
+	{
+		const u32* triangle = &indices[path[i] * 3];
+		u32 n = strip.size();
+		if ( n > 0 )
 		{
-			static u32 a[] = { 0, 0, 1 };
-			static u32 b[] = { 1, 2, 2 };
-			std::pair<u32, u32> edge(indices[i + a[j]], indices[i + b[j]]);
-			if ( edge.first > edge.second )
+			u32 oldest = strip[n - 3];
+			u32 middle = strip[n - 2];
+			u32 newest = strip[n - 1];
+			if ( HasVertex(triangle, middle) && HasVertex(triangle, newest) )
+			{
+				strip.push_back(GetThirdVertex(triangle, middle, newest));
+			}
+			else if ( HasVertex(triangle, oldest) && HasVertex(triangle, newest) )
 			{
-				std::swap(edge.first, edge.second);
+				strip.push_back(newest);
+				strip.push_back(oldest);
+				strip.push_back(GetThirdVertex(triangle, oldest, newest));
 			}
+			if ( strip.size() > n && (! honorWinding || HasLastWinding(strip, triangle)) )
+				continue;
+
+			strip.resize(n);
+			strips.Add(PRIM_TRIANGLE_STRIP, &strip[0], n);
+			strip.clear();
+		}
 
-			std::map<std::pair<u32, u32>, std::vector<u32> >::iterator it =	connections.find(edge);
-			if ( it == connections.end() )
+		// start with the vertex the next triangle doesn't share, and end with the
+		// one the triangle after it shares too so that it needs no swap
+		u32 v[3] = { triangle[0], triangle[1], triangle[2] };
+		if ( i + 1 < path.size() )
+		{
+			const u32* next = &indices[path[i + 1] * 3];
+			for ( u32 j = 0 ; j < 3 ; j++ )
 			{
-				std::pair<std::pair<u32, u32>, std::vector<u32> > entry;
-				entry.first = edge;
-				entry.second.push_back(triangle);
-				connections.insert(entry);
+				if ( HasVertex(next, triangle[(j + 1) % 3]) && HasVertex(next, triangle[(j + 2) % 3]) )
+				{
+					v[0] = triangle[j];
+					v[1] = triangle[(j + 1) % 3];
+					v[2] = triangle[(j + 2) % 3];
+					break;
+				}
 			}
-			else
+			if ( i + 2 < path.size() )
 			{
-				it->second.push_back(triangle);
+				const u32* afterNext = &indices[path[i + 2] * 3];
+				if ( HasVertex(afterNext, v[1]) && ! HasVertex(afterNext, v[2]) )
+					std::swap(v[1], v[2]);
 			}
 		}
+		if ( honorWinding && ! IsSameWinding(triangle, v[0], v[1], v[2]) )
+		{
+			// the order of the last two vertices only matters to the triangle after the next one
+			if ( i + 2 < path.size() )
+				strip.push_back(v[0]);
+			else
+				std::swap(v[1], v[2]);
+		}
+		strip.push_back(v[0]);
+		strip.push_back(v[1]);
+		strip.push_back(v[2]);
 	}
 
-	// build dual graph
-	std::vector<std::set<u32> > graph(nbTriangles);
-	for ( u32 i = 0, triangle = 0 ; i < indices.size() ; i += 3, triangle++ )
+	if ( strip.size() > 0 )
+		strips.Add(PRIM_TRIANGLE_STRIP, &strip[0], strip.size());
+}
+
+// Multi-Path Algorithm for Triangle Strips
+// Petr Vanecek, Ivana Kolingerova
+// From the draft of September 16, 2004
+void BuildTriangleStrips(const std::vector<u32>& indices, PrimitiveGroups& strips, bool honorWinding)
+{
+	std::vector<std::set<u32> > graph;
+	BuildDualGraph(indices, graph);
+
+	PathCover cover;
+	cover.Build(graph);
+
+	// every path has two ends since there are no loops, start from the first one
+	std::vector<bool> done(graph.size(), false);
+	std::vector<u32> path;
+	for ( u32 i = 0 ; i < graph.size() ; i++ )
 	{
-		for ( u32 j = 0 ; j < 3 ; j++ )
+		if ( done[i] || cover.nodes[i].nbLinks == 2 )
+			continue;
+
+		cover.GetPath(i, path);
+		for ( u32 j = 0 ; j < path.size() ; j++ )
+			done[path[j]] = true;
+		PathToStrips(path, indices, strips, honorWinding);
+	}
+
+	for ( u32 i = 0 ; i < graph.size() ; i++ )
+		ai_assert(done[i]);
+}
+
+void GetPrimitivePaths(const PrimitiveGroups& groups, const std::vector<u32>& indices,
+	const std::vector<std::set<u32> >& graph, std::vector<std::vector<u32> >& paths, PrimitiveGroups& others)
+{
+	// triangles by their sorted vertices, the same triangle may be there more than once
+	std::map<std::vector<u32>, std::vector<u32> > triangles;
+	for ( u32 t = 0 ; t < graph.size() ; t++ )
+	{
+		std::vector<u32> key(&indices[t * 3], &indices[t * 3] + 3);
+		std::sort(key.begin(), key.end());
+		triangles[key].push_back(t);
+	}
+
+	std::vector<u32> path;
+	const u32* first = groups.indices.size() > 0 ? &groups.indices[0] : 0;
+	for ( u32 i = 0 ; i < groups.GetNbPrimitives() ; first += groups.lengths[i], i++ )
+	{
+		u32 type = groups.types[i];
+		u32 count = groups.lengths[i];
+		if ( type != PRIM_TRIANGLE_STRIP && type != PRIM_TRIANGLES )
 		{
-			static u32 a[] = { 0, 0, 1 };
-			static u32 b[] = { 1, 2, 2 };
-			std::pair<u32, u32> edge(indices[i + a[j]], indices[i + b[j]]);
-			if ( edge.first > edge.second )
-			{
-				std::swap(edge.first, edge.second);
-			}
+			others.Add(type, first, count);
+			continue;
+		}
 
-			std::map<std::pair<u32, u32>, std::vector<u32> >::iterator it =	connections.find(edge);
-			if ( it != connections.end() )
+		u32 step = type == PRIM_TRIANGLES ? 3 : 1;
+		for ( u32 j = 0 ; j + 2 < count ; j += step )
+		{
+			std::vector<u32> key(first + j, first + j + 3);
+			std::sort(key.begin(), key.end());
+			if ( key[0] == key[1] || key[1] == key[2] )
+				continue;
+
+			std::map<std::vector<u32>, std::vector<u32> >::iterator it = triangles.find(key);
+			if ( it == triangles.end() || it->second.empty() )
+				continue;
+
+			u32 t = it->second.back();
+			it->second.pop_back();
+			if ( path.size() > 0 && graph[path.back()].count(t) == 0 )
 			{
-				graph[triangle].insert(it->second.begin(), it->second.end());
+				paths.push_back(path);
+				path.clear();
 			}
+			path.push_back(t);
+		}
+		if ( path.size() > 0 )
+		{
+			paths.push_back(path);
+			path.clear();
+		}
+	}
+}
+
+// Paths of the dual graph as links between nodes, the edges of the graph being either linked or free
+struct PathLinks
+{
+	const std::vector<std::set<u32> >& graph;
+	std::vector<u32> links;		// two per node
+	std::vector<u32> nbLinks;
+	std::vector<u32> visits;	// last search or check a node was seen by
+	std::vector<u32> parents;	// previous node of the tunnel being searched
+	u32 visit;
+
+	PathLinks(const std::vector<std::set<u32> >& dualGraph, const std::vector<std::vector<u32> >& paths)
+	: graph(dualGraph)
+	, links(graph.size() * 2)
+	, nbLinks(graph.size(), 0)
+	, visits(graph.size(), 0)
+	, parents(graph.size())
+	, visit(0)
+	{
+		for ( u32 p = 0 ; p < paths.size() ; p++ )
+		{
+			for ( u32 i = 0 ; i + 1 < paths[p].size() ; i++ )
+				Link(paths[p][i], paths[p][i + 1]);
 		}
-		graph[triangle].erase(triangle);
 	}
 
-	// build sets
-	std::set<u32> unconnected[4];
-	for ( u32 i = 0 ; i < nbTriangles ; i++ )
+	bool IsLinked(u32 a, u32 b) const
+	{
+		return (nbLinks[a] > 0 && links[a * 2] == b) || (nbLinks[a] > 1 && links[a * 2 + 1] == b);
+	}
+
+	void Link(u32 a, u32 b)
 	{
-		ai_assert(graph[i].size() < 4);
-		unconnected[graph[i].size()].insert(i);
+		links[a * 2 + nbLinks[a]++] = b;
+		links[b * 2 + nbLinks[b]++] = a;
 	}
 
-	std::set<u32> connected[2];
-	std::set<u32> fullyConnected;
+	void Unlink(u32 a, u32 b)
+	{
+		if ( links[a * 2] == b )
+			links[a * 2] = links[a * 2 + 1];
+		nbLinks[a]--;
+		if ( links[b * 2] == a )
+			links[b * 2] = links[b * 2 + 1];
+		nbLinks[b]--;
+	}
 
-	while ( fullyConnected.size() < nbTriangles )
+	// Breadth first search of a tunnel from start, the end of a path, to the end of another path:
+	// start, then nodes reached alternately through a free edge and through a link, the last one
+	// through a free edge
+	bool FindTunnel(u32 start, u32 maxLength, std::vector<u32>& tunnel)
 	{
-		u32 nodeSetID, nodeSetType;
-		u32 node = GetNodeFromSet(unconnected, connected, nodeSetType, nodeSetID);
-		u32 node2 = *graph[node].begin();
-		u32 node2SetID, node2SetType;
-		Find(node2, unconnected, connected, node2SetType, node2SetID);
-		if ( node2SetType == 0 )
+		visit++;
+		std::vector<u32> front(1, start), next;
+		visits[start] = visit;
+		for ( u32 length = 1 ; length <= maxLength && front.size() > 0 ; length += 2 )
 		{
-			unconnected[node2SetID].erase(node2);
+			next.clear();
+			for ( u32 i = 0 ; i < front.size() ; i++ )
+			{
+				u32 x = front[i];
+				std::set<u32>::const_iterator it;
+				for ( it = graph[x].begin() ; it != graph[x].end() ; ++it )
+				{
+					u32 y = *it;
+					if ( visits[y] == visit || IsLinked(x, y) )
+						continue;
+
+					visits[y] = visit;
+					parents[y] = x;
+					if ( nbLinks[y] < 2 )
+					{
+						tunnel.clear();
+						for ( u32 node = y ; node != start ; node = parents[node] )
+							tunnel.push_back(node);
+						tunnel.push_back(start);
+						return true;
+					}
+
+					for ( u32 j = 0 ; j < 2 ; j++ )
+					{
+						u32 z = links[y * 2 + j];
+						if ( visits[z] == visit )
+							continue;
+						visits[z] = visit;
+						parents[z] = y;
+						next.push_back(z);
+					}
+				}
+			}
+			front.swap(next);
 		}
-		else
+		return false;
+	}
+
+	// Swaps free edges and links along tunnel
+	void Flip(const std::vector<u32>& tunnel)
+	{
+		for ( u32 i = 1 ; i + 1 < tunnel.size() ; i += 2 )
+			Unlink(tunnel[i], tunnel[i + 1]);
+		for ( u32 i = 0 ; i + 1 < tunnel.size() ; i += 2 )
+			Link(tunnel[i], tunnel[i + 1]);
+	}
+
+	void Unflip(const std::vector<u32>& tunnel)
+	{
+		for ( u32 i = 0 ; i + 1 < tunnel.size() ; i += 2 )
+			Unlink(tunnel[i], tunnel[i + 1]);
+		for ( u32 i = 1 ; i + 1 < tunnel.size() ; i += 2 )
+			Link(tunnel[i], tunnel[i + 1]);
+	}
+
+	// Whether the links of the path through node make a loop
+	bool IsLoop(u32 node)
+	{
+		if ( nbLinks[node] == 0 )
+			return false;
+
+		u32 previous = node;
+		u32 current = links[node * 2];
+		while ( current != node )
 		{
-			connected[node2SetID].erase(node2);
+			visits[current] = visit;
+			if ( nbLinks[current] < 2 )
+				return false;
+			u32 next = links[current * 2] != previous ? links[current * 2] : links[current * 2 + 1];
+			previous = current;
+			current = next;
 		}
+		return true;
+	}
 
-		// Create strip
-		std::vector<u32> strip;
-		strip.push_back(node);
-		strip.push_back(node2);
+	void GetPaths(std::vector<std::vector<u32> >& paths)
+	{
+		paths.clear();
+		visit++;
+		for ( u32 node = 0 ; node < graph.size() ; node++ )
+		{
+			if ( visits[node] == visit || nbLinks[node] == 2 )
+				continue;
 
-		// Remove edge from graph
-		graph[node].erase(node2);
-		graph[node2].erase(node);
+			paths.push_back(std::vector<u32>());
+			u32 previous = node;
+			u32 current = node;
+			for ( ;; )
+			{
+				paths.back().push_back(current);
+				visits[current] = visit;
+				u32 next;
+				if ( nbLinks[current] > 0 && links[current * 2] != previous )
+					next = links[current * 2];
+				else if ( nbLinks[current] > 1 && links[current * 2 + 1] != previous )
+					next = links[current * 2 + 1];
+				else
+					break;
+				previous = current;
+				current = next;
+			}
+		}
+	}
+};
 
-		//strip = ConcatenateStrips(strip);
+u32 TunnelPaths(const std::vector<std::set<u32> >& graph, std::vector<std::vector<u32> >& paths, u32 maxLength)
+{
+	// only the nodes in the paths take part
+	std::vector<std::set<u32> > pathGraph(graph.size());
+	std::vector<bool> inPaths(graph.size(), false);
+	for ( u32 p = 0 ; p < paths.size() ; p++ )
+	{
+		for ( u32 i = 0 ; i < paths[p].size() ; i++ )
+			inPaths[paths[p][i]] = true;
+	}
+	for ( u32 node = 0 ; node < graph.size() ; node++ )
+	{
+		if ( ! inPaths[node] )
+			continue;
+		std::set<u32>::const_iterator it;
+		for ( it = graph[node].begin() ; it != graph[node].end() ; ++it )
+		{
+			if ( inPaths[*it] )
+				pathGraph[node].insert(*it);
+		}
+	}
 
-		MoveNodeToSet(node, nodeSetID, nodeSetType, connected, fullyConnected);
-		MoveNodeToSet(node2, node2SetID, node2SetType, connected, fullyConnected);
+	PathLinks links(pathGraph, paths);
 
-		//UpdateNeighbors(node);
-		//UpdateNeighbors(node2);
+	// tunnel from every path end until none finds a tunnel
+	u32 nbTunnels = 0;
+	std::vector<u32> tunnel;
+	bool found = true;
+	while ( found )
+	{
+		found = false;
+		for ( u32 node = 0 ; node < graph.size() ; node++ )
+		{
+			if ( ! inPaths[node] || links.nbLinks[node] == 2 || ! links.FindTunnel(node, maxLength, tunnel) )
+				continue;
 
-		//RemoveLoop(strip);
+			// a tunnel between the two ends of a path makes a loop, which can't be drawn
+			links.Flip(tunnel);
+			links.visit++;
+			bool loop = false;
+			for ( u32 i = 0 ; i < tunnel.size() && ! loop ; i++ )
+			{
+				if ( links.visits[tunnel[i]] != links.visit )
+					loop = links.IsLoop(tunnel[i]);
+			}
+			if ( loop )
+			{
+				links.Unflip(tunnel);
+				continue;
+			}
 
-		//UpdateNeighbors(*strip.begin());
-		if ( strip.begin() != strip.end() )
-		{
-			//UpdateNeighbors(*(strip.end() - 1));
+			nbTunnels++;
+			found = true;
 		}
 	}
 
-	std::vector<u32> strips;
-	return strips;
-}
\ No newline at end of file
+	links.GetPaths(paths);
+	return nbTunnels;
+}
+
+u32 TunnelStrips(PrimitiveGroups& groups, const std::vector<u32>& indices, const CostModel& cost, bool honorWinding)
+{
+	std::vector<std::set<u32> > graph;
+	BuildDualGraph(indices, graph);
+
+	std::vector<std::vector<u32> > paths;
+	PrimitiveGroups tunneled;
+	GetPrimitivePaths(groups, indices, graph, paths, tunneled);
+	TunnelPaths(graph, paths, MAX_TUNNEL_LENGTH);
+
+	PrimitiveGroups strips;
+	for ( u32 p = 0 ; p < paths.size() ; p++ )
+		PathToStrips(paths[p], indices, strips, honorWinding);
+	StitchStrips(strips, cost);
+	BatchTriangles(strips, cost);
+	tunneled.Add(strips);
+
+	u32 startCost = cost.GetCost(groups);
+	u32 tunneledCost = cost.GetCost(tunneled);
+	if ( tunneledCost >= startCost )
+		return 0;
+
+	groups = tunneled;
+	return startCost - tunneledCost;
+}
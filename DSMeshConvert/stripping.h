@@ -2,8 +2,51 @@
 #define _STRIPPING_H_
 
 #include <vector>
+#include <set>
 #include "types.h"
+#include "stripper.h"
+#include "primitives.h"
 
-std::vector<u32> BuildTriangleStrips(std::vector<u32> indices);
+// The dual graph of a triangle list: for each triangle, the triangles it shares an edge with
+void BuildDualGraph(const std::vector<u32>& indices, std::vector<std::set<u32> >& graph);
 
-#endif // _STRIPPING_H_
\ No newline at end of file
+// Whether triangle uses vertex v
+bool HasVertex(const u32* triangle, u32 v);
+
+// Whether the triangle (a, b, c) has the winding of triangle
+bool IsSameWinding(const u32* triangle, u32 a, u32 b, u32 c);
+
+// The vertex of triangle which is neither a nor b, or its first vertex if there's none
+u32 GetThirdVertex(const u32* triangle, u32 a, u32 b);
+
+// Appends the strips drawing path, a path of the dual graph of indices, to strips. With
+// honorWinding, every triangle is drawn with its winding in indices
+void PathToStrips(const std::vector<u32>& path, const std::vector<u32>& indices, PrimitiveGroups& strips, bool honorWinding);
+
+// Appends the triangle strips covering indices to strips
+void BuildTriangleStrips(const std::vector<u32>& indices, PrimitiveGroups& strips, bool honorWinding);
+
+// Appends the paths of graph, the dual graph of indices, followed by the triangle strips and lists
+// of groups to paths; a path ends where its primitive draws a triangle which isn't a neighbour of
+// the previous one. Other primitives are appended to others
+void GetPrimitivePaths(const PrimitiveGroups& groups, const std::vector<u32>& indices,
+	const std::vector<std::set<u32> >& graph, std::vector<std::vector<u32> >& paths, PrimitiveGroups& others);
+
+// Tunneling for Triangle Strips in Continuous Level-of-Detail Meshes
+// A. James Stewart, Graphics Interface 2001
+//
+// Merges paths along tunnels: alternating paths of graph going from the end of a path to the end
+// of another one, through edges alternately not in a path and in a path. Swapping the edges along
+// a tunnel makes one path less. Tunnels are searched up to maxLength edges, and only change the
+// links around them. Returns the number of tunnels used
+u32 TunnelPaths(const std::vector<std::set<u32> >& graph, std::vector<std::vector<u32> >& paths, u32 maxLength);
+
+// The tunnel length the strippers search up to: longer tunnels are rare and cost more to find
+// than they save
+static const u32 MAX_TUNNEL_LENGTH = 32;
+
+// Tunnels the triangle strips and lists of groups, keeping the result if it's smaller. With
+// honorWinding, the new strips draw every triangle with its winding in indices. Returns the bytes saved
+u32 TunnelStrips(PrimitiveGroups& groups, const std::vector<u32>& indices, const CostModel& cost, bool honorWinding);
+
+#endif // _STRIPPING_H_
@@ -0,0 +1,289 @@
+#include "thread.h"
+#include <windows.h>
+#include <vector>
+
+struct ThreadPool::State
+{
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE wake;     // a new batch is ready, or the pool is closing
+	CONDITION_VARIABLE done;     // the last worker of a batch is finished
+	HANDLE* threads;
+
+	u32 batch;                   // incremented every time a batch is posted
+	u32 busy;                    // #threads still working on the current batch
+	bool quit;
+
+	ParallelJob job;
+	void* userData;
+	u32 nbJobs;
+	volatile LONG next;          // next job index to hand out
+};
+
+struct WorkerParam
+{
+	ThreadPool* pool;
+	u32 worker;
+};
+
+u32 GetNbProcessors()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+ThreadPool::ThreadPool(u32 nbWorkers)
+{
+	mNbWorkers = nbWorkers > 0 ? nbWorkers : GetNbProcessors();
+
+	mState = new State;
+	InitializeCriticalSection(&mState->lock);
+	InitializeConditionVariable(&mState->wake);
+	InitializeConditionVariable(&mState->done);
+	mState->batch = 0;
+	mState->busy = 0;
+	mState->quit = false;
+	mState->job = 0;
+	mState->userData = 0;
+	mState->nbJobs = 0;
+	mState->next = 0;
+
+	// worker 0 is whoever calls Run(). If a thread can't be started the pool keeps the workers
+	// started so far, down to running every job on the caller alone.
+	mState->threads = new HANDLE[mNbWorkers];
+	for ( u32 i = 1 ; i < mNbWorkers ; i++ )
+	{
+		WorkerParam* param = new WorkerParam;
+		param->pool = this;
+		param->worker = i;
+		mState->threads[i] = CreateThread(0, 0, WorkerMain, param, 0, 0);
+		if ( mState->threads[i] == 0 )
+		{
+			delete param;
+			mNbWorkers = i;
+			break;
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	EnterCriticalSection(&mState->lock);
+	mState->quit = true;
+	WakeAllConditionVariable(&mState->wake);
+	LeaveCriticalSection(&mState->lock);
+
+	for ( u32 i = 1 ; i < mNbWorkers ; i++ )
+	{
+		WaitForSingleObject(mState->threads[i], INFINITE);
+		CloseHandle(mState->threads[i]);
+	}
+
+	DeleteCriticalSection(&mState->lock);
+	delete[] mState->threads;
+	delete mState;
+}
+
+void ThreadPool::Run(u32 nbJobs, ParallelJob job, void* userData)
+{
+	if ( nbJobs == 0 )
+		return;
+
+	if ( mNbWorkers == 1 || nbJobs == 1 )
+	{
+		for ( u32 i = 0 ; i < nbJobs ; i++ )
+			job(i, 0, userData);
+		return;
+	}
+
+	EnterCriticalSection(&mState->lock);
+	mState->job = job;
+	mState->userData = userData;
+	mState->nbJobs = nbJobs;
+	mState->next = 0;
+	mState->busy = mNbWorkers - 1;
+	mState->batch++;
+	WakeAllConditionVariable(&mState->wake);
+	LeaveCriticalSection(&mState->lock);
+
+	Work(0);
+
+	EnterCriticalSection(&mState->lock);
+	while ( mState->busy > 0 )
+		SleepConditionVariableCS(&mState->done, &mState->lock, INFINITE);
+	LeaveCriticalSection(&mState->lock);
+}
+
+void ThreadPool::Work(u32 worker)
+{
+	for ( ;; )
+	{
+		u32 index = (u32)(InterlockedIncrement(&mState->next) - 1);
+		if ( index >= mState->nbJobs )
+			break;
+		mState->job(index, worker, mState->userData);
+	}
+}
+
+unsigned long __stdcall ThreadPool::WorkerMain(void* param)
+{
+	WorkerParam* p = (WorkerParam*)param;
+	ThreadPool* pool = p->pool;
+	State* state = pool->mState;
+	u32 worker = p->worker;
+	delete p;
+
+	u32 seen = 0;
+	for ( ;; )
+	{
+		EnterCriticalSection(&state->lock);
+		while ( state->batch == seen && ! state->quit )
+			SleepConditionVariableCS(&state->wake, &state->lock, INFINITE);
+		if ( state->quit )
+		{
+			LeaveCriticalSection(&state->lock);
+			return 0;
+		}
+		seen = state->batch;
+		LeaveCriticalSection(&state->lock);
+
+		pool->Work(worker);
+
+		EnterCriticalSection(&state->lock);
+		if ( --state->busy == 0 )
+			WakeConditionVariable(&state->done);
+		LeaveCriticalSection(&state->lock);
+	}
+}
+
+struct WorkQueue::State
+{
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE notFull;
+	CONDITION_VARIABLE notEmpty;
+	void** items;                // ring buffer
+	u32 capacity;
+	u32 first;
+	u32 count;
+	u32 producers;               // #producers which haven't called Done() yet
+};
+
+WorkQueue::WorkQueue(u32 capacity, u32 nbProducers)
+{
+	mState = new State;
+	InitializeCriticalSection(&mState->lock);
+	InitializeConditionVariable(&mState->notFull);
+	InitializeConditionVariable(&mState->notEmpty);
+	mState->capacity = capacity > 0 ? capacity : 1;
+	mState->items = new void*[mState->capacity];
+	mState->first = 0;
+	mState->count = 0;
+	mState->producers = nbProducers;
+}
+
+WorkQueue::~WorkQueue()
+{
+	DeleteCriticalSection(&mState->lock);
+	delete[] mState->items;
+	delete mState;
+}
+
+void WorkQueue::Push(void* item)
+{
+	EnterCriticalSection(&mState->lock);
+	while ( mState->count == mState->capacity )
+		SleepConditionVariableCS(&mState->notFull, &mState->lock, INFINITE);
+	mState->items[(mState->first + mState->count) % mState->capacity] = item;
+	mState->count++;
+	WakeConditionVariable(&mState->notEmpty);
+	LeaveCriticalSection(&mState->lock);
+}
+
+void* WorkQueue::Pop()
+{
+	EnterCriticalSection(&mState->lock);
+	while ( mState->count == 0 && mState->producers > 0 )
+		SleepConditionVariableCS(&mState->notEmpty, &mState->lock, INFINITE);
+
+	void* item = 0;
+	if ( mState->count > 0 )
+	{
+		item = mState->items[mState->first];
+		mState->first = (mState->first + 1) % mState->capacity;
+		mState->count--;
+		WakeConditionVariable(&mState->notFull);
+	}
+	LeaveCriticalSection(&mState->lock);
+	return item;
+}
+
+void WorkQueue::Done()
+{
+	EnterCriticalSection(&mState->lock);
+	// the consumers waiting on an empty queue have nothing more to wait for
+	if ( --mState->producers == 0 )
+		WakeAllConditionVariable(&mState->notEmpty);
+	LeaveCriticalSection(&mState->lock);
+}
+
+struct ThreadGroup::State
+{
+	std::vector<HANDLE> threads;
+};
+
+struct ThreadParam
+{
+	ParallelJob job;
+	void* userData;
+	u32 index;
+};
+
+ThreadGroup::ThreadGroup()
+{
+	mState = new State;
+}
+
+ThreadGroup::~ThreadGroup()
+{
+	Join();
+	delete mState;
+}
+
+u32 ThreadGroup::Start(u32 nbThreads, ParallelJob job, void* userData)
+{
+	for ( u32 i = 0 ; i < nbThreads ; i++ )
+	{
+		ThreadParam* param = new ThreadParam;
+		param->job = job;
+		param->userData = userData;
+		param->index = i;
+		HANDLE thread = CreateThread(0, 0, ThreadMain, param, 0, 0);
+		if ( thread == 0 )
+		{
+			delete param;
+			return i;
+		}
+		mState->threads.push_back(thread);
+	}
+	return nbThreads;
+}
+
+void ThreadGroup::Join()
+{
+	for ( u32 i = 0 ; i < mState->threads.size() ; i++ )
+	{
+		WaitForSingleObject(mState->threads[i], INFINITE);
+		CloseHandle(mState->threads[i]);
+	}
+	mState->threads.clear();
+}
+
+unsigned long __stdcall ThreadGroup::ThreadMain(void* param)
+{
+	ThreadParam* p = (ThreadParam*)param;
+	ThreadParam local = *p;
+	delete p;
+
+	local.job(local.index, local.index, local.userData);
+	return 0;
+}
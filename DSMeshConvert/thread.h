@@ -0,0 +1,84 @@
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+#include "types.h"
+
+// Called once per job index, worker is in [0, GetNbWorkers()) and can be used
+// to pick per-thread scratch data
+typedef void (*ParallelJob)(u32 index, u32 worker, void* userData);
+
+u32 GetNbProcessors();
+
+// A fixed set of threads which run batches of jobs. The calling thread takes
+// part in every batch as worker 0, so a pool of one worker runs inline.
+class ThreadPool
+{
+public:
+	ThreadPool(u32 nbWorkers = 0); // 0 => one worker per processor
+	~ThreadPool();
+
+	u32 GetNbWorkers() const { return mNbWorkers; }
+
+	// Runs job for every index in [0, nbJobs) and returns when all are done
+	void Run(u32 nbJobs, ParallelJob job, void* userData);
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	struct State;
+	static unsigned long __stdcall WorkerMain(void* param);
+	void Work(u32 worker);
+
+	u32 mNbWorkers;
+	State* mState;
+};
+
+// A bounded first in, first out queue of items handed from one set of threads to another.
+// Push blocks while the queue is full and Pop while it is empty. Every producer calls Done
+// once it won't push anymore, after which Pop returns 0 when the queue is empty.
+class WorkQueue
+{
+public:
+	WorkQueue(u32 capacity, u32 nbProducers = 1);
+	~WorkQueue();
+
+	void Push(void* item);
+	void* Pop();
+	void Done();
+
+private:
+	WorkQueue(const WorkQueue&);
+	WorkQueue& operator=(const WorkQueue&);
+
+	struct State;
+	State* mState;
+};
+
+// Threads started each on a function of their own, until Join. Unlike the pool,
+// the calling thread doesn't take part
+class ThreadGroup
+{
+public:
+	ThreadGroup();
+	~ThreadGroup(); // joins
+
+	// Starts nbThreads threads running job(i, i, userData) for i in [0, nbThreads). Returns the
+	// number of threads started, less than nbThreads if one couldn't be, the next ones being
+	// left out
+	u32 Start(u32 nbThreads, ParallelJob job, void* userData);
+
+	// Waits for all the threads started so far
+	void Join();
+
+private:
+	ThreadGroup(const ThreadGroup&);
+	ThreadGroup& operator=(const ThreadGroup&);
+
+	struct State;
+	static unsigned long __stdcall ThreadMain(void* param);
+
+	State* mState;
+};
+
+#endif // _THREAD_H_
@@ -3,6 +3,7 @@
 
 typedef signed int s32;
 typedef unsigned int u32;
+typedef unsigned long long u64;
 typedef unsigned short u16;
 typedef unsigned char u8;
 
@@ -1,37 +1,21 @@
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <vector>
 #define AI_WONT_RETURN
 #include "../DSMeshConvert/assimp--1.1.700-sdk/include/aiVector3D.h"
 #include "../DSMeshConvert/assimp--1.1.700-sdk/include/aiMatrix4x4.h"
 #include "../DSMeshConvert/assimp--1.1.700-sdk/include/aiMatrix4x4.inl"
+#include "../DSMeshConvert/pack.h"
+#include "../DSMeshConvert/decompress.h"
+#include "../DSMeshConvert/chunks.h"
 
-typedef unsigned int u32;
-typedef signed int s32;
-
-int main(int argc, char** argv)
+// Prints the commands of a display list of len words
+void DumpDisplayList(const u32* list, u32 len)
 {
-	if ( argc != 2 )
-	{
-		fprintf(stderr, "Usage: %s <file.msh>\n", argv[0]);
-		return 42;
-	}
-
-	FILE* f = fopen(argv[1], "rb");
-	if ( ! f )
-	{
-		fprintf(stderr, "Could not open %s\n", argv[1]);
-		return 1;
-	}
-
-	fseek(f, 0, SEEK_END);
-	u32 len = ftell(f) / 4;
-	fseek(f, 0, SEEK_SET);
-
-	u32* list = new u32[len];
-	u32* start = list;
-	u32* end = list + len;
-
-	fread(list, 4, len, f);
+	if ( len == 0 )
+		return;
+	const u32* end = list + len;
 
 	aiMatrix4x4 mtx;
 	float* pMtx = (float*)(&mtx);
@@ -62,7 +46,7 @@ int main(int argc, char** argv)
 			}
 			case 0x21: // normal
 			{
-				s32 n = *list;
+				s32 n = *list++;
 				s32 nx = n & 0x3FF; if ( nx > 0x200 ) nx -= 0x200;
 				s32 ny = (n >> 10) & 0x3FF; if ( ny >= 0x200 ) ny -= 0x400;
 				s32 nz = (n >> 20) & 0x3FF; if ( nz >= 0x200 ) nz -= 0x400;
@@ -108,14 +92,137 @@ int main(int argc, char** argv)
 		}
 
 		index += 8;
-		if ( index == 32 )
+		if ( index == 32 && list < end )
 		{
 			index = 0;
 			command = *list++;
 		}
 	}
 
-	delete[] start;
+}
+
+// Prints the index of a chunked display list of len words, then its commands, which are those
+// of the chunks one after the other
+void DumpChunkedDisplayList(const u32* list, u32 len)
+{
+	const ChunkHeader* header = (const ChunkHeader*)list;
+	const ChunkEntry* chunks = (const ChunkEntry*)(header + 1);
+	if ( len * 4 < sizeof(ChunkHeader) || (len * 4 - sizeof(ChunkHeader)) / sizeof(ChunkEntry) < header->nbChunks )
+	{
+		fprintf(stderr, "Truncated chunk index\n");
+		return;
+	}
+
+	std::vector<u32> commands;
+	for ( u32 i = 0 ; i < header->nbChunks ; i++ )
+	{
+		const ChunkEntry& c = chunks[i];
+		printf("chunk %d: offset %d, %d bytes\n", i, c.offset, c.size);
+		if ( c.offset % CHUNK_ALIGNMENT != 0 || c.size % 4 != 0 || c.offset > len * 4 || c.size > len * 4 - c.offset )
+		{
+			fprintf(stderr, "Chunk %d is out of the display list or misaligned\n", i);
+			return;
+		}
+		commands.insert(commands.end(), list + c.offset / 4, list + (c.offset + c.size) / 4);
+	}
+	DumpDisplayList(commands.empty() ? 0 : &commands[0], commands.size());
+}
+
+// Prints the commands of a display list of size bytes as it was written, decompressing it first
+// if it was compressed
+void DumpStoredDisplayList(const u32* list, u32 size, bool compressed)
+{
+	if ( ! compressed )
+	{
+		if ( size >= 4 && list[0] == CHUNK_MAGIC )
+			DumpChunkedDisplayList(list, size / 4);
+		else
+			DumpDisplayList(list, size / 4);
+		return;
+	}
+
+	std::vector<u8> bytes;
+	if ( ! Decompress((const u8*)list, size, bytes) )
+	{
+		fprintf(stderr, "Corrupt compressed display list\n");
+		return;
+	}
+	printf("compressed 0x%x, %d bytes decompressed\n", *(const u8*)list, bytes.size());
+	std::vector<u32> words((bytes.size() + 3) / 4);
+	if ( ! bytes.empty() )
+		memcpy(&words[0], &bytes[0], bytes.size());
+	DumpStoredDisplayList(words.empty() ? 0 : &words[0], words.size() * 4, false);
+}
 
+// Prints the entries of a pack of size bytes, and the display list of the one named name
+// or of all of them if name is 0
+int DumpPack(const char* data, u32 size, const char* name)
+{
+	const PackHeader* header = (const PackHeader*)data;
+	if ( header->version != PACK_VERSION || header->size > size
+		|| sizeof(PackHeader) + header->nbEntries * sizeof(PackEntry) > size )
+	{
+		fprintf(stderr, "Unsupported or truncated pack, version %d\n", header->version);
+		return 2;
+	}
+
+	const PackEntry* entries = (const PackEntry*)(header + 1);
+	for ( u32 i = 0 ; i < header->nbEntries ; i++ )
+	{
+		const PackEntry& e = entries[i];
+		printf("entry %d %.*s LOD %d: offset %d, %d bytes, compression 0x%x, chunks of %d bytes, %d triangles, %d primitives, error %f\n",
+			i, PACK_NAME_LENGTH, e.name, e.lod, e.offset, e.size, e.compression, e.chunkSize, e.nbTriangles, e.nbPrimitives, e.error);
+		printf("  box %f %f %f - %f %f %f\n", e.boxMin[0], e.boxMin[1], e.boxMin[2], e.boxMax[0], e.boxMax[1], e.boxMax[2]);
+		printf("  scale %f %f %f translate %f %f %f\n", e.scale[0], e.scale[1], e.scale[2], e.translate[0], e.translate[1], e.translate[2]);
+		if ( e.offset % PACK_ALIGNMENT != 0 || e.offset + e.size > header->size )
+		{
+			fprintf(stderr, "Entry %d is out of the pack or misaligned\n", i);
+			return 2;
+		}
+	}
+
+	for ( u32 i = 0 ; i < header->nbEntries ; i++ )
+	{
+		if ( name == 0 || strncmp(entries[i].name, name, PACK_NAME_LENGTH) == 0 )
+		{
+			printf("display list %.*s LOD %d\n", PACK_NAME_LENGTH, entries[i].name, entries[i].lod);
+			DumpStoredDisplayList((const u32*)(data + entries[i].offset), entries[i].size, entries[i].compression != 0);
+		}
+	}
 	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if ( argc != 2 && argc != 3 )
+	{
+		fprintf(stderr, "Usage: %s <file.msh>\n", argv[0]);
+		fprintf(stderr, "       %s <pack> [<entry>]\n", argv[0]);
+		return 42;
+	}
+
+	FILE* f = fopen(argv[1], "rb");
+	if ( ! f )
+	{
+		fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	u32 size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	// words, for the display lists to be aligned
+	u32* data = new u32[(size + 3) / 4];
+	fread(data, 1, size, f);
+	fclose(f);
+
+	int result = 0;
+	if ( size >= sizeof(PackHeader) && data[0] == PACK_MAGIC )
+		result = DumpPack((const char*)data, size, argc == 3 ? argv[2] : 0);
+	else
+		DumpStoredDisplayList(data, size, IsCompressed((const u8*)data, size));	// a list starts with 0x19
+
+	delete[] data;
+	return result;
 }
\ No newline at end of file